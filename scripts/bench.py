@@ -0,0 +1,133 @@
+import argparse
+import json
+import os
+import platform
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+# drives ./stil over generated corpora and records how fast it went
+#
+# usage: bench.py [--stil ./stil] [--sizes 10000,100000,1000000] [--runs 7]
+#                 [--out bench-results.json]
+#
+# every size is run through --lex, --parse and the full dump, timing each run
+# from the outside and pulling token/allocation counts out of --stats
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+MODES = {
+    "lex": ["--lex"],
+    "parse": ["--parse"],
+    "dump": [],
+}
+
+
+def gen_corpus(dir, n_tokens):
+    path = os.path.join(dir, f"bench-{n_tokens}.st")
+    subprocess.run(
+        [sys.executable, os.path.join(HERE, "stgen.py"), str(n_tokens), path,
+         "--parseable"],
+        check=True, stdout=subprocess.DEVNULL)
+    return path
+
+
+def parse_stats(out):
+    stats = {}
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) == 3 and parts[0] == "stat":
+            stats[parts[1]] = int(parts[2])
+    return stats
+
+
+# one run of stil, returns (wall seconds, peak rss in KiB, stats)
+def run_once(stil, flags, path):
+    start = time.perf_counter()
+    proc = subprocess.Popen([stil, *flags, "--stats", path],
+                            stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+    out = proc.stdout.read()
+    _, status, usage = os.wait4(proc.pid, 0)
+    wall = time.perf_counter() - start
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    if proc.returncode != 0:
+        sys.exit(f"{stil} {' '.join(flags)} {path} exited with "
+                 f"{proc.returncode}")
+    return wall, usage.ru_maxrss, parse_stats(out.decode(errors="replace"))
+
+
+def p95(samples):
+    ordered = sorted(samples)
+    return ordered[min(len(ordered) - 1, round(0.95 * (len(ordered) - 1)))]
+
+
+def bench(stil, path, flags, runs):
+    size = os.path.getsize(path)
+    # first run warms the page cache and isn't counted
+    run_once(stil, flags, path)
+
+    times, rss = [], []
+    stats = {}
+    for _ in range(runs):
+        wall, maxrss, stats = run_once(stil, flags, path)
+        times.append(wall)
+        rss.append(maxrss)
+
+    median = statistics.median(times)
+    tokens = stats.get("tokens", 0)
+    return {
+        "bytes": size,
+        "tokens": tokens,
+        "runs": runs,
+        "median_s": median,
+        "p95_s": p95(times),
+        "tokens_per_s": tokens / median if median else 0,
+        "mb_per_s": size / (1024 * 1024) / median if median else 0,
+        "peak_rss_kb": max(rss),
+        "allocs": stats.get("allocs", 0),
+        "arena_bytes": stats.get("arena_bytes", 0),
+    }
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--stil", default="./stil")
+    ap.add_argument("--sizes", default="10000,100000,1000000")
+    ap.add_argument("--runs", type=int, default=7)
+    ap.add_argument("--out", default="bench-results.json")
+    args = ap.parse_args()
+
+    if not os.access(args.stil, os.X_OK):
+        sys.exit(f"{args.stil} isn't there, run make first")
+
+    results = []
+    with tempfile.TemporaryDirectory(prefix="stil-bench-") as dir:
+        for n in (int(s) for s in args.sizes.split(",")):
+            path = gen_corpus(dir, n)
+            for mode, flags in MODES.items():
+                r = bench(args.stil, path, flags, args.runs)
+                r["mode"] = mode
+                r["size"] = n
+                results.append(r)
+                print(f"{mode:>6} {n:>9} tokens  "
+                      f"median {r['median_s'] * 1000:8.2f} ms  "
+                      f"p95 {r['p95_s'] * 1000:8.2f} ms  "
+                      f"{r['tokens_per_s'] / 1e6:7.2f} Mtok/s  "
+                      f"{r['mb_per_s']:7.2f} MB/s  "
+                      f"rss {r['peak_rss_kb'] / 1024:7.1f} MB  "
+                      f"allocs {r['allocs']}")
+
+    with open(args.out, "w") as f:
+        json.dump({
+            "machine": platform.machine(),
+            "cpus": os.cpu_count(),
+            "timestamp": int(time.time()),
+            "results": results,
+        }, f, indent=2)
+    print(f"Wrote {args.out}")
+
+
+if __name__ == "__main__":
+    main()
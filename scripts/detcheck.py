@@ -0,0 +1,149 @@
+import argparse
+import os
+import random
+import re
+import subprocess
+import sys
+import tempfile
+
+# checks that building a project gives the same output whatever the thread
+# count and however the files got scheduled
+#
+# usage: detcheck.py [--stil ./stil] [--files 40] [--runs 4] [--seed 1]
+#
+# The files share names but spell them in different cases, so anything that
+# leaks one file's spelling into another's output shows up. Every build has
+# to match the -j 1 one, and every file has to come out the same as when
+# it's built on its own. Then the same again out of a cache that was filled
+# by building all of them together
+
+THREADS = [1, 2, 4, 8]
+MODES = {
+    "dump": [],
+    "ir": ["--ir"],
+}
+
+NAMES = ["Counter", "Total", "Flag", "Speed"]
+
+ANSI = re.compile(r"\x1b\[[0-9;]*m")
+TIME_LINE = re.compile(r"time: .* seconds")
+FILE_LINE = re.compile(r"^INFO (\S+\.st)$")
+
+
+def spelling(name):
+    return "".join(c.upper() if random.random() < 0.5 else c.lower()
+                   for c in name)
+
+
+# one unit with a few of the shared names, sized so files take noticeably
+# different times
+def write_file(path, n):
+    names = random.sample(NAMES, random.randint(1, len(NAMES)))
+    with open(path, "w") as f:
+        f.write(f"PROGRAM prg_{n}\n    VAR\n")
+        for name in names:
+            f.write(f"        {spelling(name)} : INT;\n")
+        f.write("    END_VAR\n")
+        for _ in range(random.randint(1, 200)):
+            a, b = random.choice(names), random.choice(names)
+            f.write(f"    {spelling(a)} := {spelling(b)} + 1;\n")
+        f.write("END_PROGRAM\n")
+
+
+# without a cache unless it's given one
+def build(stil, flags, inputs, threads, cache=None):
+    env = dict(os.environ)
+    if cache:
+        env["STIL_CACHE_DIR"] = cache
+    else:
+        flags = ["--no-cache", *flags]
+    proc = subprocess.run([stil, "-j", str(threads), *flags, *inputs],
+                          env=env, stdout=subprocess.PIPE,
+                          stderr=subprocess.STDOUT)
+    out = proc.stdout.decode(errors="replace")
+    if proc.returncode != 0:
+        sys.exit(f"{stil} {' '.join(flags)} exited with {proc.returncode}:\n"
+                 f"{out}")
+    return "".join(ANSI.sub("", line)
+                   for line in out.splitlines(keepends=True)
+                   if not TIME_LINE.search(line))
+
+
+# the output of each file, by path
+def sections(out):
+    found, path = {}, None
+    for line in out.splitlines(keepends=True):
+        m = FILE_LINE.match(line)
+        if m:
+            path = m.group(1)
+            found[path] = ""
+        elif path:
+            found[path] += line
+    return found
+
+
+# paths that don't come out the same when built on their own
+def differ_alone(stil, flags, dir, paths, whole, cache=None):
+    # a one line manifest, so it still goes through the driver
+    manifest = os.path.join(dir, "alone.txt")
+    differ = []
+    for path in paths:
+        with open(manifest, "w") as f:
+            f.write(os.path.basename(path) + "\n")
+        alone = sections(build(stil, flags, ["@" + manifest], 1, cache))
+        if path not in whole or alone.get(path) != whole[path]:
+            differ.append(path)
+    return differ
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--stil", default="./stil")
+    ap.add_argument("--files", type=int, default=40)
+    ap.add_argument("--runs", type=int, default=4)
+    ap.add_argument("--seed", type=int, default=1)
+    args = ap.parse_args()
+
+    if not os.access(args.stil, os.X_OK):
+        sys.exit(f"{args.stil} isn't there, run make first")
+    random.seed(args.seed)
+
+    failed = False
+    with tempfile.TemporaryDirectory(prefix="stil-det-") as dir:
+        paths = []
+        for n in range(args.files):
+            paths.append(os.path.join(dir, f"f{n}.st"))
+            write_file(paths[-1], n)
+
+        # only trees are cached, so there's no point doing it for --ir
+        cache = os.path.join(dir, "cache")
+        for mode, flags in MODES.items():
+            expected = build(args.stil, flags, [dir], 1)
+            caches = [None]
+            if not flags:
+                # filled by building everything together
+                build(args.stil, flags, [dir], THREADS[-1], cache)
+                caches.append(cache)
+
+            for using in caches:
+                what = f"{mode}{' from the cache' if using else ''}"
+                for threads in THREADS:
+                    for run in range(args.runs):
+                        out = build(args.stil, flags, [dir], threads, using)
+                        if out != expected:
+                            print(f"{what}: -j {threads} run {run} differs "
+                                  f"from -j 1")
+                            failed = True
+                for path in differ_alone(args.stil, flags, dir, paths,
+                                         sections(expected), using):
+                    print(f"{what}: {path} differs when built on its own")
+                    failed = True
+
+    if failed:
+        sys.exit(1)
+    print(f"Builds of {args.files} files matched at -j "
+          f"{','.join(map(str, THREADS))}")
+
+
+if __name__ == "__main__":
+    main()
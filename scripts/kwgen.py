@@ -0,0 +1,221 @@
+import sys
+
+# Generates src/keywords.c, a perfect hash for case insensitive keyword lookup.
+#
+#   python3 scripts/kwgen.py > src/keywords.c
+#
+# Every keyword lands in its own slot, so a lookup is one hash over the
+# lexeme, one displacement read and one compare against the stored spelling.
+# Hashing and comparing both fold case with `c & 0xDF`, which is only sound
+# because lexemes handed to kw_lookup are made of [A-Za-z0-9_@#] and no
+# keyword has a digit or one of @#
+
+keywords = [
+    ("PROGRAM", "TOKEN_KEYWORD_PROGRAM"),
+    ("CLASS", "TOKEN_KEYWORD_CLASS"),
+    ("END_CLASS", "TOKEN_KEYWORD_END_CLASS"),
+    ("ENDCLASS", "TOKEN_KEYWORD_END_CLASS"),
+    ("EXTENDS", "TOKEN_KEYWORD_EXTENDS"),
+    ("IMPLEMENTS", "TOKEN_KEYWORD_IMPLEMENTS"),
+    ("INTERFACE", "TOKEN_KEYWORD_INTERFACE"),
+    ("END_INTERFACE", "TOKEN_KEYWORD_END_INTERFACE"),
+    ("ENDINTERFACE", "TOKEN_KEYWORD_END_INTERFACE"),
+    ("PROPERTY", "TOKEN_KEYWORD_PROPERTY"),
+    ("END_PROPERTY", "TOKEN_KEYWORD_END_PROPERTY"),
+    ("ENDPROPERTY", "TOKEN_KEYWORD_END_PROPERTY"),
+    ("VAR_INPUT", "TOKEN_KEYWORD_VAR_INPUT"),
+    ("VARINPUT", "TOKEN_KEYWORD_VAR_INPUT"),
+    ("VAR_OUTPUT", "TOKEN_KEYWORD_VAR_OUTPUT"),
+    ("VAROUTPUT", "TOKEN_KEYWORD_VAR_OUTPUT"),
+    ("VAR", "TOKEN_KEYWORD_VAR"),
+    ("VAR_CONFIG", "TOKEN_KEYWORD_VAR_CONFIG"),
+    ("ABSTRACT", "TOKEN_KEYWORD_ABSTRACT"),
+    ("FINAL", "TOKEN_KEYWORD_FINAL"),
+    ("METHOD", "TOKEN_KEYWORD_METHOD"),
+    ("CONSTANT", "TOKEN_KEYWORD_CONSTANT"),
+    ("RETAIN", "TOKEN_KEYWORD_RETAIN"),
+    ("NON_RETAIN", "TOKEN_KEYWORD_NON_RETAIN"),
+    ("NONRETAIN", "TOKEN_KEYWORD_NON_RETAIN"),
+    ("VAR_TEMP", "TOKEN_KEYWORD_VAR_TEMP"),
+    ("VARTEMP", "TOKEN_KEYWORD_VAR_TEMP"),
+    ("END_METHOD", "TOKEN_KEYWORD_END_METHOD"),
+    ("ENDMETHOD", "TOKEN_KEYWORD_END_METHOD"),
+    ("PUBLIC", "TOKEN_KEYWORD_ACCESS_PUBLIC"),
+    ("PRIVATE", "TOKEN_KEYWORD_ACCESS_PRIVATE"),
+    ("INTERNAL", "TOKEN_KEYWORD_ACCESS_INTERNAL"),
+    ("PROTECTED", "TOKEN_KEYWORD_ACCESS_PROTECTED"),
+    ("OVERRIDE", "TOKEN_KEYWORD_OVERRIDE"),
+    ("VAR_GLOBAL", "TOKEN_KEYWORD_VAR_GLOBAL"),
+    ("VARGLOBAL", "TOKEN_KEYWORD_VAR_GLOBAL"),
+    ("VAR_IN_OUT", "TOKEN_KEYWORD_VAR_IN_OUT"),
+    ("VARINOUT", "TOKEN_KEYWORD_VAR_IN_OUT"),
+    ("VAR_EXTERNAL", "TOKEN_KEYWORD_VAR_EXTERNAL"),
+    ("END_VAR", "TOKEN_KEYWORD_END_VAR"),
+    ("ENDVAR", "TOKEN_KEYWORD_END_VAR"),
+    ("END_PROGRAM", "TOKEN_KEYWORD_END_PROGRAM"),
+    ("ENDPROGRAM", "TOKEN_KEYWORD_END_PROGRAM"),
+    ("FUNCTION", "TOKEN_KEYWORD_FUNCTION"),
+    ("END_FUNCTION", "TOKEN_KEYWORD_END_FUNCTION"),
+    ("ENDFUNCTION", "TOKEN_KEYWORD_END_FUNCTION"),
+    ("FUNCTION_BLOCK", "TOKEN_KEYWORD_FUNCTION_BLOCK"),
+    ("FUNCTIONBLOCK", "TOKEN_KEYWORD_FUNCTION_BLOCK"),
+    ("END_FUNCTION_BLOCK", "TOKEN_KEYWORD_END_FUNCTION_BLOCK"),
+    ("ENDFUNCTIONBLOCK", "TOKEN_KEYWORD_END_FUNCTION_BLOCK"),
+    ("TYPE", "TOKEN_KEYWORD_TYPE"),
+    ("STRUCT", "TOKEN_KEYWORD_STRUCT"),
+    ("END_TYPE", "TOKEN_KEYWORD_END_TYPE"),
+    ("ENDTYPE", "TOKEN_KEYWORD_END_TYPE"),
+    ("END_STRUCT", "TOKEN_KEYWORD_END_STRUCT"),
+    ("ENDSTRUCT", "TOKEN_KEYWORD_END_STRUCT"),
+    ("ACTIONS", "TOKEN_KEYWORD_ACTIONS"),
+    ("ACTION", "TOKEN_KEYWORD_ACTION"),
+    ("END_ACTION", "TOKEN_KEYWORD_END_ACTION"),
+    ("ENDACTION", "TOKEN_KEYWORD_END_ACTION"),
+    ("END_ACTIONS", "TOKEN_KEYWORD_END_ACTIONS"),
+    ("ENDACTIONS", "TOKEN_KEYWORD_END_ACTIONS"),
+    ("IF", "TOKEN_KEYWORD_IF"),
+    ("THEN", "TOKEN_KEYWORD_THEN"),
+    ("ELSIF", "TOKEN_KEYWORD_ELSE_IF"),
+    ("ELSE", "TOKEN_KEYWORD_ELSE"),
+    ("END_IF", "TOKEN_KEYWORD_END_IF"),
+    ("ENDIF", "TOKEN_KEYWORD_END_IF"),
+    ("FOR", "TOKEN_KEYWORD_FOR"),
+    ("TO", "TOKEN_KEYWORD_TO"),
+    ("BY", "TOKEN_KEYWORD_BY"),
+    ("DO", "TOKEN_KEYWORD_DO"),
+    ("END_FOR", "TOKEN_KEYWORD_END_FOR"),
+    ("ENDFOR", "TOKEN_KEYWORD_END_FOR"),
+    ("WHILE", "TOKEN_KEYWORD_WHILE"),
+    ("END_WHILE", "TOKEN_KEYWORD_END_WHILE"),
+    ("ENDWHILE", "TOKEN_KEYWORD_END_WHILE"),
+    ("REPEAT", "TOKEN_KEYWORD_REPEAT"),
+    ("UNTIL", "TOKEN_KEYWORD_UNTIL"),
+    ("END_REPEAT", "TOKEN_KEYWORD_END_REPEAT"),
+    ("ENDREPEAT", "TOKEN_KEYWORD_END_REPEAT"),
+    ("CASE", "TOKEN_KEYWORD_CASE"),
+    ("RETURN", "TOKEN_KEYWORD_RETURN"),
+    ("EXIT", "TOKEN_KEYWORD_EXIT"),
+    ("CONTINUE", "TOKEN_KEYWORD_CONTINUE"),
+    ("POINTER", "TOKEN_KEYWORD_POINTER"),
+    ("REF_TO", "TOKEN_KEYWORD_REFERENCE_TO"),
+    ("REFTO", "TOKEN_KEYWORD_REFERENCE_TO"),
+    ("ARRAY", "TOKEN_KEYWORD_ARRAY"),
+    ("STRING", "TOKEN_KEYWORD_STRING"),
+    ("WSTRING", "TOKEN_KEYWORD_WIDE_STRING"),
+    ("OF", "TOKEN_KEYWORD_OF"),
+    ("AT", "TOKEN_KEYWORD_AT"),
+    ("END_CASE", "TOKEN_KEYWORD_END_CASE"),
+    ("ENDCASE", "TOKEN_KEYWORD_END_CASE"),
+    ("INT", "TOKEN_KEYWORD_INT"),
+    ("REAL", "TOKEN_KEYWORD_REAL"),
+    ("BOOL", "TOKEN_KEYWORD_BOOL"),
+    ("TRUE", "TOKEN_LITERAL_TRUE"),
+    ("FALSE", "TOKEN_LITERAL_FALSE"),
+    ("MOD", "TOKEN_OPERATOR_MODULO"),
+    ("AND", "TOKEN_OPERATOR_AND"),
+    ("OR", "TOKEN_OPERATOR_OR"),
+    ("XOR", "TOKEN_OPERATOR_XOR"),
+    ("NOT", "TOKEN_OPERATOR_NOT"),
+]
+
+TABLE_LEN = 256
+N_BUCKETS = 64
+FNV_OFFSET_BASIS = 2166136261
+FNV_PRIME = 16777619
+MIX = 0x9E3779B1
+MASK32 = 0xFFFFFFFF
+
+
+def fold_hash(word):
+    h = FNV_OFFSET_BASIS
+    for c in word.encode():
+        h = ((h ^ (c & 0xDF)) * FNV_PRIME) & MASK32
+    return h
+
+
+def slot_of(h, disp):
+    return (((h ^ (disp * MIX)) & MASK32) * 0x85EBCA6B & MASK32) >> 24
+
+
+def build():
+    buckets = [[] for _ in range(N_BUCKETS)]
+    for word, kind in keywords:
+        buckets[fold_hash(word) % N_BUCKETS].append((word, kind))
+
+    displacements = [0] * N_BUCKETS
+    slots = [None] * TABLE_LEN
+    order = sorted(range(N_BUCKETS), key=lambda b: -len(buckets[b]))
+    for b in order:
+        if not buckets[b]:
+            continue
+        for disp in range(1 << 16):
+            taken = [slot_of(fold_hash(w), disp) for w, _ in buckets[b]]
+            if len(set(taken)) == len(taken) and all(slots[s] is None for s in taken):
+                for s, entry in zip(taken, buckets[b]):
+                    slots[s] = entry
+                displacements[b] = disp
+                break
+        else:
+            sys.exit(f"no displacement found for bucket {b}")
+    return displacements, slots
+
+
+def emit(displacements, slots):
+    max_len = max(len(w) for w, _ in keywords)
+    min_len = min(len(w) for w, _ in keywords)
+    out = []
+    out.append("// Generated by scripts/kwgen.py, do not edit by hand")
+    out.append('#include "keywords.h"')
+    out.append("#include <stdint.h>")
+    out.append("")
+    out.append(f"#define KW_MIN_LEN {min_len}")
+    out.append(f"#define KW_MAX_LEN {max_len}")
+    out.append("")
+    out.append("typedef struct _KwSlot {")
+    out.append("    const char *spelling;")
+    out.append("    uint8_t len;")
+    out.append("    int kind;")
+    out.append("} KwSlot;")
+    out.append("")
+    out.append(f"static const uint16_t kw_displacements[{N_BUCKETS}] = {{")
+    for i in range(0, N_BUCKETS, 8):
+        row = ", ".join(str(d) for d in displacements[i:i + 8])
+        out.append(f"    {row},")
+    out.append("};")
+    out.append("")
+    out.append(f"static const KwSlot kw_slots[{TABLE_LEN}] = {{")
+    for i, entry in enumerate(slots):
+        if entry:
+            word, kind = entry
+            out.append(f'    [{i}] = {{"{word}", {len(word)}, {kind}}},')
+    out.append("};")
+    out.append("")
+    out.append("int kw_lookup(const char *lexeme, size_t len) {")
+    out.append("    if(len < KW_MIN_LEN || len > KW_MAX_LEN) {")
+    out.append("        return -1;")
+    out.append("    }")
+    out.append("")
+    out.append(f"    uint32_t h = {FNV_OFFSET_BASIS}u;")
+    out.append("    for(size_t i = 0; i < len; i++) {")
+    out.append("        h = (h ^ (uint8_t)(lexeme[i] & 0xDF)) * "
+               f"{FNV_PRIME}u;")
+    out.append("    }")
+    out.append("")
+    out.append(f"    uint32_t disp = kw_displacements[h % {N_BUCKETS}];")
+    out.append(f"    uint32_t slot = ((h ^ (disp * 0x{MIX:X}u)) * 0x85EBCA6Bu) >> 24;")
+    out.append("    const KwSlot *kw = &kw_slots[slot];")
+    out.append("    if(kw->len != len) {")
+    out.append("        return -1;")
+    out.append("    }")
+    out.append("    for(size_t i = 0; i < len; i++) {")
+    out.append("        if((lexeme[i] & 0xDF) != kw->spelling[i]) {")
+    out.append("            return -1;")
+    out.append("        }")
+    out.append("    }")
+    out.append("    return kw->kind;")
+    out.append("}")
+    print("\n".join(out))
+
+
+if __name__ == "__main__":
+    emit(*build())
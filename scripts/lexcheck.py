@@ -0,0 +1,153 @@
+import argparse
+import hashlib
+import os
+import subprocess
+import sys
+import tempfile
+
+# checks that lexing on several threads gives exactly the tokens the serial
+# lexer does
+#
+# usage: lexcheck.py [--stil ./stil] [--mb 10]
+#
+# Every input is lexed with --tokens at each of THREADS and through stdin,
+# which goes through the streaming lexer, and has to match -j 1. Files only
+# get split once there's a MiB per thread, so the inputs are made big enough
+# for all of THREADS to actually be used
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+THREADS = [2, 3, 4, 8, 9]
+
+# things that can run across the newlines the source gets cut at, or look
+# like they start something they don't
+TRICKY = (
+    "x := 'a string\nthat runs over\nseveral lines';\n"
+    "(* a comment\n   with a ' quote and a (* in it\n*)\n"
+    "y := '(* not a comment';\n"
+    "z := 'it''s' + \"wide\";\n"
+    "a := 1; (* one line *) b := 2 ** 3;\n"
+    "(**)(*\n*)'\n'\n"
+)
+
+
+def stgen(path, n_tokens, parseable):
+    subprocess.run(
+        [sys.executable, os.path.join(HERE, "stgen.py"), str(n_tokens), path,
+         *(["--parseable"] if parseable else [])],
+        check=True, stdout=subprocess.DEVNULL)
+
+
+# nearly every newline in here is inside a string or a comment, so that's
+# where a cut lands unless the splitting knows better
+LONG = (
+    "s := '" + "a line of a string\n" * 30 + "';\n"
+    "(*" + " a line of a comment\n" * 30 + "*)\n"
+)
+
+
+# plain stgen output with TRICKY dropped in between its lines every so often
+def tricky(base, size):
+    with open(base, "rb") as f:
+        lines = f.read().split(b"\n")
+    out = []
+    n = 0
+    while n < size:
+        for i, line in enumerate(lines):
+            out.append(line + b"\n")
+            n += len(line) + 1
+            if i % 200 == 0:
+                out.append(TRICKY.encode())
+                n += len(TRICKY)
+    return b"".join(out)
+
+
+# something put in the middle, with close taken out of everything after it
+# so it really never gets closed
+def with_middle(data, insert, close=None):
+    mid = data.index(b"\n", len(data) // 2) + 1
+    rest = data[mid:].replace(close, b"") if close else data[mid:]
+    return data[:mid] + insert + rest
+
+
+def make_inputs(dir, mb):
+    size = mb * 1024 * 1024
+    soup = os.path.join(dir, "soup.st")
+    parseable = os.path.join(dir, "parseable.st")
+    # a token comes to about 7 bytes
+    stgen(soup, size // 7, False)
+    stgen(parseable, size // 7, True)
+
+    data = tricky(parseable, size)
+    inputs = {
+        "soup": soup,
+        "parseable": parseable,
+        "tricky": data,
+        "long": LONG.encode() * (size // len(LONG) + 1),
+        "unclosed-string": with_middle(data, b"s := 'never closed\n", b"'"),
+        "unclosed-comment": with_middle(data, b"(* never closed\n", b"*)"),
+        "nul": with_middle(data, b"n := 1;\0 m := 2;\n"),
+        "crlf": data.replace(b"\n", b"\r\n"),
+        "no-final-newline": data.rstrip(b"\n") + b" c := 'end'",
+    }
+    for name, contents in inputs.items():
+        if isinstance(contents, bytes):
+            inputs[name] = os.path.join(dir, f"{name}.st")
+            with open(inputs[name], "wb") as f:
+                f.write(contents)
+    return inputs
+
+
+# Hash of the token stream and of whatever got reported along the way. The
+# streaming lexer prints tokens as it goes, so a warning ends up among them
+# rather than before, which is why the two are kept apart
+def lex(stil, path, threads=None):
+    if threads:
+        proc = subprocess.run([stil, "--tokens", "-j", str(threads), path],
+                              stdout=subprocess.PIPE)
+    else:
+        with open(path, "rb") as f:
+            proc = subprocess.run([stil, "--tokens", "-"], stdin=f,
+                                  stdout=subprocess.PIPE)
+    if proc.returncode != 0:
+        sys.exit(f"{stil} --tokens on {path} exited with {proc.returncode}")
+    tokens, reported = hashlib.sha256(), hashlib.sha256()
+    n = 0
+    for line in proc.stdout.splitlines(keepends=True):
+        if line[:1].isdigit():
+            tokens.update(line)
+            n += 1
+        elif not line.startswith(b"Lexing time"):
+            reported.update(line)
+    return (tokens.hexdigest(), reported.hexdigest()), n
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--stil", default="./stil")
+    ap.add_argument("--mb", type=int, default=10)
+    args = ap.parse_args()
+
+    if not os.access(args.stil, os.X_OK):
+        sys.exit(f"{args.stil} isn't there, run make first")
+
+    failed = False
+    with tempfile.TemporaryDirectory(prefix="stil-lex-") as dir:
+        for name, path in make_inputs(dir, args.mb).items():
+            expected, n_tokens = lex(args.stil, path, 1)
+            differ = [str(j) for j in THREADS
+                      if lex(args.stil, path, j)[0] != expected]
+            if lex(args.stil, path)[0] != expected:
+                differ.append("stdin")
+            if differ:
+                print(f"{name}: -j {', '.join(differ)} differ from -j 1")
+                failed = True
+            else:
+                print(f"{name}: {n_tokens} tokens match")
+
+    if failed:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,6 +1,12 @@
 import random
+import sys
 
 # used to generate a million token file to benchmark lexing
+#
+# usage: stgen.py [num_tokens] [out_file] [--parseable]
+#
+# --parseable writes PROGRAM/ACTION units the parser actually accepts instead
+# of a keyword soup, so the same corpus can be pushed through lex+parse
 
 tokens = [
     "PROGRAM", "CLASS", "END_CLASS", "EXTENDS", "IMPLEMENTS", "INTERFACE", "END_INTERFACE",
@@ -18,14 +24,65 @@ tokens = [
 
 idents = ["myVar", "tempValue", "sensor_1", "x_coord", "loopCounter"]
 
-num_tokens = 1_000_000
-out_file = "milltokens.st"
 
-with open(out_file, "w") as f:
-    for _ in range(num_tokens):
-        if random.random() < 0.20:  # 20% chance we get an identifier
-            f.write(random.choice(idents) + " ")
+def literal(ty):
+    if ty == "INT":
+        return str(random.randint(0, 100000))
+    if ty == "REAL":
+        return f"{random.uniform(0, 1000):.3f}"
+    return "'" + random.choice(idents) + "'"
+
+
+# writes one unit and returns roughly how many tokens it took
+def write_unit(f, n):
+    names = [f"{random.choice(idents)}_{i}" for i in range(random.randint(2, 8))]
+    types = {name: random.choice(["INT", "REAL", "STRING"]) for name in names}
+    written = 0
+
+    f.write(f"PROGRAM prg_{n}\n    VAR\n")
+    written += 3
+    for name in names:
+        if random.random() < 0.5:
+            f.write(f"        {name}: {types[name]} := {literal(types[name])};\n")
+            written += 6
         else:
-            f.write(random.choice(tokens) + " ")
+            f.write(f"        {name}: {types[name]};\n")
+            written += 4
+    f.write("    END_VAR\nEND_PROGRAM\n\n")
+    written += 2
+
+    f.write(f"ACTION act_{n}\n")
+    written += 2
+    for _ in range(random.randint(1, 6)):
+        name = random.choice(names)
+        f.write(f"    {name} := {literal(types[name])};\n")
+        written += 4
+    f.write("END_ACTION\n\n")
+    written += 1
+
+    return written
+
+
+def main():
+    args = [a for a in sys.argv[1:] if not a.startswith("--")]
+    parseable = "--parseable" in sys.argv[1:]
+    num_tokens = int(args[0]) if len(args) > 0 else 1_000_000
+    out_file = args[1] if len(args) > 1 else "milltokens.st"
+
+    with open(out_file, "w") as f:
+        if parseable:
+            written = 0
+            while written < num_tokens:
+                written += write_unit(f, written)
+        else:
+            for _ in range(num_tokens):
+                if random.random() < 0.20:  # 20% chance we get an identifier
+                    f.write(random.choice(idents) + " ")
+                else:
+                    f.write(random.choice(tokens) + " ")
+
+    print(f"Generated {num_tokens} tokens in {out_file}")
+
 
-print(f"Generated {num_tokens} tokens in {out_file}")
+if __name__ == "__main__":
+    main()
@@ -21,8 +21,9 @@ static uintptr_t align_forward(uintptr_t ptr, size_t align) {
 }
 
 Arena arena_init(size_t size) {
+    // only address space is taken up front, pages get backed as they're used
     void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
-                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
     if(mem == MAP_FAILED) {
         stil_fatal("Couldn't mmap memory for arena: %s", strerror(errno));
     }
@@ -48,6 +49,40 @@ void *arena_alloc(Arena *arena, size_t size) {
     return arena_alloc_align(arena, size, DEFAULT_ALIGNMENT);
 }
 
+char *arena_strndup(Arena *arena, const char *s, size_t len) {
+    char *dup = arena_alloc_align(arena, len + 1, 1);
+    memcpy(dup, s, len);
+    dup[len] = '\0';
+    return dup;
+}
+
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size,
+                    size_t new_size) {
+    if(!ptr) {
+        return arena_alloc(arena, new_size);
+    }
+    if(new_size <= old_size) {
+        return ptr;
+    }
+
+    uint8_t *old = ptr;
+    if(old + old_size == arena->buf + arena->offset &&
+       (size_t)(old - arena->buf) + new_size <= arena->size) {
+        memset(old + old_size, 0, new_size - old_size);
+        arena->offset = (old - arena->buf) + new_size;
+        return ptr;
+    }
+
+    void *grown = arena_alloc(arena, new_size);
+    memcpy(grown, ptr, old_size);
+    return grown;
+}
+
 void arena_reset(Arena *arena) { arena->offset = 0; }
 
+void arena_rewind(Arena *arena, size_t offset) {
+    assert(offset <= arena->offset);
+    arena->offset = offset;
+}
+
 void arena_deinit(Arena *arena) { munmap(arena->buf, arena->size); }
@@ -22,8 +22,19 @@ Arena arena_init(size_t size);
 // TODO genericize this to allow array allocations
 void *arena_alloc(Arena *arena, size_t size);
 
+// copies len bytes of s into the arena and NUL terminates them
+char *arena_strndup(Arena *arena, const char *s, size_t len);
+
+// Grows ptr, an earlier allocation of old_size bytes, to new_size. The last
+// allocation is grown in place, anything else gets copied to a fresh spot
+// and the old one is just left behind until the next reset
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+
 void arena_reset(Arena *arena);
 
+// Frees everything allocated since arena->offset was offset
+void arena_rewind(Arena *arena, size_t offset);
+
 void arena_deinit(Arena *arena);
 
 #endif
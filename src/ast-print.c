@@ -56,68 +56,124 @@ char *st_unit_type_dbg(StUnitType ty) {
     }
 }
 
-void ast_dump(ASTNode *root) {
+char *infix_op_dbg(InfixOperator op) {
+    switch(op) {
+        case OP_ADD:
+            return "+";
+        case OP_SUB:
+            return "-";
+        case OP_MUL:
+            return "*";
+        case OP_DIV:
+            return "/";
+        case OP_MOD:
+            return "MOD";
+        case OP_POW:
+            return "**";
+        case OP_LT:
+            return "<";
+        case OP_LTE:
+            return "<=";
+        case OP_GT:
+            return ">";
+        case OP_GTE:
+            return ">=";
+        case OP_EQ:
+            return "=";
+        case OP_NE:
+            return "<>";
+        case OP_AND:
+            return "AND";
+        case OP_OR:
+            return "OR";
+        case OP_XOR:
+            return "XOR";
+        case NO_INFIX:
+            break;
+    }
+    return "";
+}
+
+char *prefix_op_dbg(PrefixOperator op) {
+    switch(op) {
+        case OP_NEG:
+            return "-";
+        case OP_NOT:
+            return "NOT";
+        case NO_PREFIX:
+            break;
+    }
+    return "";
+}
+
+void ast_dump(ASTNode *root, const Lexer *lexer) {
     stil_info("======AST======");
-    astnode_dbg(root);
+    astnode_dbg(root, lexer);
 }
 
-void print_st_unit(STUnit *unit, size_t indent) {
+void print_st_unit(STUnit *unit, const Lexer *lexer, size_t indent) {
     INDENTED(indent, "%s:", st_unit_type_dbg(unit->unit_type));
-    INDENTED(indent + 1, "NAME: %s", unit->name->label);
+    StrView name = symbol_spelling(lexer, unit->name);
+    INDENTED(indent + 1, "NAME: " SV_FMT, SV_ARG(name));
 
     if(unit->variable_blocks->count > 0) {
         INDENTED(indent + 1, "VARIABLE_DECLARATIONS:");
         for(size_t i = 0; i < unit->variable_blocks->count; i++) {
-            astnode_dbg_indented(unit->variable_blocks->nodes[i], indent + 2);
+            astnode_dbg_indented(astnode_list_at(unit->variable_blocks, i),
+                                 lexer, indent + 2);
         }
     }
 
     if(unit->statements->count > 0) {
         INDENTED(indent + 1, "BODY:");
         for(size_t i = 0; i < unit->statements->count; i++) {
-            astnode_dbg_indented(unit->statements->nodes[i], indent + 2);
+            astnode_dbg_indented(astnode_list_at(unit->statements, i),
+                                 lexer, indent + 2);
         }
     }
 }
 
-void comp_unit_dump(CompilationUnit *comp_unit) {
+void comp_unit_dump(CompilationUnit *comp_unit, const Lexer *lexer) {
     stil_info("======AST======");
     for(size_t i = 0; i < comp_unit->st_units->count; i++) {
-        print_st_unit(comp_unit->st_units->units[i], 0);
+        print_st_unit(st_unit_list_at(comp_unit->st_units, i), lexer, 0);
     }
 }
 
-void print_var_decl(VarDeclaration *decl, size_t indent) {
+void print_var_decl(VarDeclaration *decl, const Lexer *lexer, size_t indent) {
     INDENTED(indent, "VAR DECLARATION:");
     INDENTED_NONEW(indent + 1, "Symbols: ");
     for(size_t i = 0; i < decl->labels->count; i++) {
+        StrView name = symbol_spelling(lexer, symbol_list_at(decl->labels, i));
         if(i == 0) {
-            printf("%s", decl->labels->symbols[i]->label);
+            printf(SV_FMT, SV_ARG(name));
         } else {
-            printf(", %s", decl->labels->symbols[i]->label);
+            printf(", " SV_FMT, SV_ARG(name));
         }
     }
     printf("\n");
     INDENTED(indent + 1, "TYPE: %s", type_dbg(decl->type));
     if(decl->value) {
         INDENTED(indent + 1, "VALUE:");
-        astnode_dbg_indented(decl->value, indent + 2);
+        astnode_dbg_indented(decl->value, lexer, indent + 2);
     }
 }
 
-void print_var_decl_block(VarBlock *block, size_t indent) {
+void print_var_decl_block(VarBlock *block, const Lexer *lexer, size_t indent) {
     INDENTED(indent, "VAR DECLARATION BLOCK (%s):",
              var_block_type_dbg(block->block_type));
     for(size_t i = 0; i < block->var_decls->count; i++) {
-        print_var_decl(&block->var_decls->nodes[i]->var_decl, indent + 1);
+        print_var_decl(&astnode_list_at(block->var_decls, i)->var_decl,
+                       lexer, indent + 1);
     }
 }
 
-void print_assignment(Assignment *asgmt, size_t indent) {
+void print_assignment(Assignment *asgmt, const Lexer *lexer, size_t indent) {
     INDENTED(indent, "ASSIGNMENT:");
-    INDENTED(indent + 1, "LHS: %s", asgmt->name->label);
+    StrView name = symbol_spelling(lexer, asgmt->name);
+    INDENTED(indent + 1, "LHS: " SV_FMT, SV_ARG(name));
     INDENTED(indent + 1, "RHS:");
-    astnode_dbg_indented(asgmt->value, indent + 2);
+    astnode_dbg_indented(asgmt->value, lexer, indent + 2);
 }
 
 void print_int_literal(IntLiteral *int_literal, size_t indent) {
@@ -132,22 +188,44 @@ void print_str_literal(StrLiteral *str_literal, size_t indent) {
     INDENTED(indent, "STR LITERAL: %s", str_literal->str_val);
 }
 
-void astnode_dbg_indented(ASTNode *node, size_t indent) {
+void print_bool_literal(BoolLiteral *bool_literal, size_t indent) {
+    INDENTED(indent, "BOOL LITERAL: %s",
+             bool_literal->bool_val ? "TRUE" : "FALSE");
+}
+
+void print_binary_expr(BinaryExpr *expr, const Lexer *lexer, size_t indent) {
+    INDENTED(indent, "BINARY EXPR (%s):", infix_op_dbg(expr->op));
+    INDENTED(indent + 1, "LHS:");
+    astnode_dbg_indented(expr->lhs, lexer, indent + 2);
+    INDENTED(indent + 1, "RHS:");
+    astnode_dbg_indented(expr->rhs, lexer, indent + 2);
+}
+
+void print_unary_expr(UnaryExpr *expr, const Lexer *lexer, size_t indent) {
+    INDENTED(indent, "UNARY EXPR (%s):", prefix_op_dbg(expr->op));
+    astnode_dbg_indented(expr->operand, lexer, indent + 1);
+}
+
+void astnode_dbg_indented(ASTNode *node, const Lexer *lexer, size_t indent) {
     if(!node) {
         return;
     }
 
     switch(node->kind) {
         case ASNTNODE_VAR_DECLARATION_BLOCK:
-            print_var_decl_block(&node->var_block, indent);
+            print_var_decl_block(&node->var_block, lexer, indent);
             break;
         case ASNTNODE_VAR_DECLARATION:
-            print_var_decl(&node->var_decl, indent);
+            print_var_decl(&node->var_decl, lexer, indent);
             break;
         case ASTNODE_IF_STMT:
         case ASTNODE_COND_THEN_BLOCK:
+            break;
         case ASTNODE_UNARY_EXPR:
+            print_unary_expr(&node->unary_expr, lexer, indent);
+            break;
         case ASTNODE_BINARY_EXPR:
+            print_binary_expr(&node->binary_expr, lexer, indent);
             break;
         case ASTNODE_INT_LITERAL:
             print_int_literal(&node->int_literal, indent);
@@ -159,18 +237,24 @@ void astnode_dbg_indented(ASTNode *node, size_t indent) {
             print_str_literal(&node->str_literal, indent);
             break;
         case ASTNODE_BOOL_LITERAL:
-        case ASTNODE_SYMBOL:
+            print_bool_literal(&node->bool_literal, indent);
             break;
+        case ASTNODE_SYMBOL:
+            {
+                StrView name = symbol_spelling(lexer, &node->symbol);
+                INDENTED(indent, "SYMBOL: " SV_FMT, SV_ARG(name));
+                break;
+            }
 
         case ASTNODE_CHUNK:
             stil_info("UNIMPLEMENTED");
             break;
         case ASTNODE_PROGRAM:
-            /* print_st_unit(&node->st_unit, indent); */
+            /* print_st_unit(&node->st_unit, lexer, indent); */
             break;
 
         case ASTNODE_ASSIGNMENT_STMT:
-            print_assignment(&node->asgmt, indent);
+            print_assignment(&node->asgmt, lexer, indent);
             break;
     }
 }
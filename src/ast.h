@@ -1,7 +1,12 @@
 #ifndef AST_H
 #define AST_H
 
+#include "arena.h"
+#include "intern.h"
+#include "lexer.h"
+#include <stdbool.h>
 #include "shared.h"
+#include "vec.h"
 
 #define INDENTED(depth, format, ...)                                           \
     do {                                                                       \
@@ -47,6 +52,7 @@ typedef enum {
     OP_MUL,
     OP_DIV,
     OP_MOD,
+    OP_POW,
 
     OP_LT,
     OP_LTE,
@@ -83,6 +89,21 @@ typedef enum _TypeDecl {
     NO_TYPE,
 } TypeDecl;
 
+// Index into a CompilationUnit's types. Each distinct type is in there
+// exactly once, so two types are the same type exactly when their ids are
+// equal. TYPE_ID_NONE stands for a type that couldn't be worked out, which
+// has already been reported
+typedef uint32_t TypeId;
+
+#define TYPE_ID_NONE 0
+
+typedef struct _Type {
+    TypeDecl kind;
+    InternId name;
+} Type;
+
+VEC_DEFINE(TypeList, type_list, Type)
+
 typedef enum _LinkageType {
     LINKAGE_INTERNAL,
     LINKAGE_EXTERNAL,
@@ -112,19 +133,30 @@ typedef enum _StUnitType {
 typedef struct _ASTNode ASTNode;
 typedef struct _STUnit STUnit;
 
+// Everything below hangs off the arena handed to the parser and is released
+// along with it, nothing in the tree is freed on its own
+
+// id is the interned name, so symbols naming the same thing have the same
+// id whatever their case. How this occurrence spelled it is left in the
+// source, see symbol_spelling
 typedef struct _Symbol {
-    char *label;
+    InternId id;
+    uint32_t offset; // where it is in the source
+    // what the name refers to, filled in by resolve_comp_unit
+    struct _VarDeclaration *decl;
 } Symbol;
 
-typedef struct _SymbolList {
-    Symbol **symbols;
-    size_t count, cap;
-} SymbolList;
+// Straight out of the source lexer holds, so only good for as long as the
+// lexer is. Case is all interning ever changes, so the interned name is as
+// long as the spelling
+static inline StrView symbol_spelling(const Lexer *lexer,
+                                      const Symbol *symbol) {
+    return (StrView){.ptr = lexer->whole + (symbol->offset - lexer->base),
+                     .len = intern_len(symbol->id)};
+}
 
-typedef struct _ASTNodeList {
-    ASTNode **nodes;
-    size_t count, cap;
-} ASTNodeList;
+VEC_DEFINE(SymbolList, symbol_list, Symbol *)
+VEC_DEFINE(ASTNodeList, astnode_list, ASTNode *)
 
 struct _STUnit {
     StUnitType unit_type;
@@ -132,12 +164,14 @@ struct _STUnit {
     ASTNodeList *variable_blocks; // have to be of type VarBlock
     ASTNodeList *statements;
     TypeDecl ReturnType; // set to NO_RETURN_TYPE if not a function
+
+    // where the unit sits in the source, from its first token to the end of
+    // its last, and a stil_hash of those bytes. See reparse.h
+    size_t span_start, span_end;
+    uint64_t hash;
 };
 
-typedef struct _STUnitList {
-    STUnit **units;
-    size_t count, cap;
-} STUnitList;
+VEC_DEFINE(STUnitList, st_unit_list, STUnit *)
 
 typedef struct _CompilationUnit {
     // global_vars;
@@ -149,7 +183,8 @@ typedef struct _CompilationUnit {
      **/
     // ASTNodeList *nodes;
     STUnitList *st_units;
-
+    // filled in by sema_comp_unit, NULL until then
+    TypeList *types;
 } CompilationUnit;
 
 typedef struct _VarBlock {
@@ -160,6 +195,8 @@ typedef struct _VarBlock {
 typedef struct _VarDeclaration {
     SymbolList *labels;
     TypeDecl type;
+    Symbol *type_name; // when type is NO_TYPE, the name it was given instead
+    TypeId type_id;    // filled in by sema_comp_unit
     ASTNode *value;
 } VarDeclaration;
 
@@ -191,8 +228,24 @@ typedef struct _StrLiteral {
     char *str_val;
 } StrLiteral;
 
+typedef struct _BoolLiteral {
+    bool bool_val;
+} BoolLiteral;
+
+typedef struct _BinaryExpr {
+    InfixOperator op;
+    ASTNode *lhs;
+    ASTNode *rhs;
+} BinaryExpr;
+
+typedef struct _UnaryExpr {
+    PrefixOperator op;
+    ASTNode *operand;
+} UnaryExpr;
+
 struct _ASTNode {
     NodeKind kind;
+    TypeId type_id; // of an expression, filled in by sema_comp_unit
 
     union {
         STUnit st_unit;
@@ -203,24 +256,28 @@ struct _ASTNode {
         IntLiteral int_literal;
         RealLiteral real_literal;
         StrLiteral str_literal;
+        BoolLiteral bool_literal;
+        BinaryExpr binary_expr;
+        UnaryExpr unary_expr;
     };
 };
 
-#define astnode_dbg(node) astnode_dbg_indented(node, 0);
-
-void astnode_dbg_indented(ASTNode *node, size_t indent);
-void ast_dump(ASTNode *root);
-void comp_unit_dump(CompilationUnit *comp_unit);
-void print_st_unit(STUnit *unit, size_t indent);
-
-SymbolList *symbol_list_init();
-void symbol_list_push(SymbolList *list, Symbol *symbol);
-void symbol_list_show(const SymbolList *list);
-ASTNodeList *astnode_list_init();
-void astnode_list_push(ASTNodeList *list, ASTNode *node);
-void astnode_list_show(const ASTNodeList *list);
-STUnitList *st_unit_list_init();
-void st_unit_list_push(STUnitList *list, STUnit *unit);
+#define astnode_dbg(node, lexer) astnode_dbg_indented(node, lexer, 0);
+
+char *type_dbg(TypeDecl ty);
+char *var_block_type_dbg(VarBlockType ty);
+char *st_unit_type_dbg(StUnitType ty);
+char *infix_op_dbg(InfixOperator op);
+char *prefix_op_dbg(PrefixOperator op);
+// the lexer is the one the tree was parsed from, names are printed the way
+// they're spelled in its source
+void astnode_dbg_indented(ASTNode *node, const Lexer *lexer, size_t indent);
+void ast_dump(ASTNode *root, const Lexer *lexer);
+void comp_unit_dump(CompilationUnit *comp_unit, const Lexer *lexer);
+void print_st_unit(STUnit *unit, const Lexer *lexer, size_t indent);
+
+void symbol_list_show(const SymbolList *list, const Lexer *lexer);
+void astnode_list_show(const ASTNodeList *list, const Lexer *lexer);
 // void st_unit_list_show(const STUnitList *list);
 
 #endif
@@ -0,0 +1,193 @@
+#define _GNU_SOURCE
+#include "cache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC "STILAST"
+// bump whenever the layout below or anything in flat-ast.h changes
+#define CACHE_FORMAT 2
+
+// Everything after the header is found through these offsets, which are
+// from the start of the file and 8 byte aligned
+typedef struct _CacheHeader {
+    char magic[8];
+    uint32_t format;
+    uint32_t root;
+    uint64_t key;
+    uint64_t source_len;
+    uint64_t n_tokens;
+    uint32_t n_nodes, n_extra, strings_len;
+    uint64_t diag_len;
+    uint64_t kinds_at, payloads_at, extra_at, strings_at, diag_at;
+} CacheHeader;
+
+const char *cache_dir() {
+    const char *dir = getenv("STIL_CACHE_DIR");
+    return dir && *dir ? dir : CACHE_DEFAULT_DIR;
+}
+
+// seeded with the version so a new compiler never sees entries an old one
+// wrote
+CacheKey cache_key(const char *source, size_t len) {
+    uint64_t seed = stil_hash(STIL_VERSION, strlen(STIL_VERSION), 0);
+    return (CacheKey){.hash = stil_hash(source, len, seed), .source_len = len};
+}
+
+static void entry_path(char *buf, size_t size, const char *dir, CacheKey key) {
+    snprintf(buf, size, "%s/%016" PRIx64 ".ast", dir, key.hash);
+}
+
+static bool fits(uint64_t at, uint64_t len, size_t size) {
+    return at <= size && len <= size - at;
+}
+
+bool cache_load(const char *dir, CacheKey key, CacheEntry *entry) {
+    char path[4096];
+    entry_path(path, sizeof path, dir, key);
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(CacheHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) {
+        return false;
+    }
+
+    // anything off about it and it's treated like it isn't there
+    const CacheHeader *h = map;
+    const uint8_t *base = map;
+    if(memcmp(h->magic, CACHE_MAGIC, sizeof h->magic) != 0 ||
+       h->format != CACHE_FORMAT || h->key != key.hash ||
+       h->source_len != key.source_len ||
+       !fits(h->kinds_at, h->n_nodes, size) ||
+       !fits(h->payloads_at, (uint64_t)h->n_nodes * sizeof(FlatPayload),
+             size) ||
+       !fits(h->extra_at, (uint64_t)h->n_extra * sizeof(uint32_t), size) ||
+       !fits(h->strings_at, h->strings_len, size) ||
+       !fits(h->diag_at, h->diag_len, size)) {
+        munmap(map, size);
+        return false;
+    }
+
+    *entry = (CacheEntry){
+        .ast =
+            {
+                .kinds = (uint8_t *)(base + h->kinds_at),
+                .payloads = (FlatPayload *)(base + h->payloads_at),
+                .n_nodes = h->n_nodes,
+                .extra = (uint32_t *)(base + h->extra_at),
+                .n_extra = h->n_extra,
+                .strings = (char *)(base + h->strings_at),
+                .strings_len = h->strings_len,
+                .root = h->root,
+            },
+        .n_tokens = h->n_tokens,
+        .diag = (const char *)(base + h->diag_at),
+        .diag_len = h->diag_len,
+        .map = map,
+        .map_len = size,
+    };
+    // the sections are all there, but what's in them is only as good as
+    // the file, which anyone could have mangled
+    if(!flat_ast_check(&entry->ast)) {
+        munmap(map, size);
+        return false;
+    }
+    return true;
+}
+
+static bool make_dirs(const char *dir) {
+    char path[4096];
+    size_t len = strlen(dir);
+    if(len >= sizeof path) {
+        return false;
+    }
+    memcpy(path, dir, len + 1);
+    for(size_t i = 1; i <= len; i++) {
+        if(path[i] == '/' || path[i] == '\0') {
+            char c = path[i];
+            path[i] = '\0';
+            if(mkdir(path, 0755) < 0 && errno != EEXIST) {
+                return false;
+            }
+            path[i] = c;
+        }
+    }
+    return true;
+}
+
+static uint64_t align8(uint64_t n) { return (n + 7) & ~(uint64_t)7; }
+
+static bool write_at(FILE *f, uint64_t at, const void *data, size_t len) {
+    static const char zeros[8];
+    long pos = ftell(f);
+    return pos >= 0 && (uint64_t)pos <= at &&
+           fwrite(zeros, 1, at - pos, f) == at - pos &&
+           fwrite(data, 1, len, f) == len;
+}
+
+void cache_store(const char *dir, CacheKey key, const FlatAST *ast,
+                 size_t n_tokens, const char *diag, size_t diag_len) {
+    if(!make_dirs(dir)) {
+        return;
+    }
+
+    CacheHeader h = {
+        .magic = CACHE_MAGIC,
+        .format = CACHE_FORMAT,
+        .root = ast->root,
+        .key = key.hash,
+        .source_len = key.source_len,
+        .n_tokens = n_tokens,
+        .n_nodes = ast->n_nodes,
+        .n_extra = ast->n_extra,
+        .strings_len = ast->strings_len,
+        .diag_len = diag_len,
+    };
+    h.kinds_at = align8(sizeof h);
+    h.payloads_at = align8(h.kinds_at + h.n_nodes);
+    h.extra_at = align8(h.payloads_at + h.n_nodes * sizeof(FlatPayload));
+    h.strings_at = align8(h.extra_at + h.n_extra * sizeof(uint32_t));
+    h.diag_at = align8(h.strings_at + h.strings_len);
+
+    // written next to where it goes and renamed into place, so nobody ever
+    // maps half an entry, however many of us are writing at once
+    char path[4096], tmp[4096 + 64];
+    entry_path(path, sizeof path, dir, key);
+    snprintf(tmp, sizeof tmp, "%s.%d.%lu.tmp", path, getpid(),
+             (unsigned long)pthread_self());
+    FILE *f = fopen(tmp, "wb");
+    if(!f) {
+        return;
+    }
+    bool ok = write_at(f, 0, &h, sizeof h) &&
+              write_at(f, h.kinds_at, ast->kinds, h.n_nodes) &&
+              write_at(f, h.payloads_at, ast->payloads,
+                       h.n_nodes * sizeof(FlatPayload)) &&
+              write_at(f, h.extra_at, ast->extra,
+                       h.n_extra * sizeof(uint32_t)) &&
+              write_at(f, h.strings_at, ast->strings, h.strings_len) &&
+              write_at(f, h.diag_at, diag, diag_len);
+    ok = fclose(f) == 0 && ok;
+    if(!ok || rename(tmp, path) < 0) {
+        unlink(tmp);
+    }
+}
+
+void cache_release(CacheEntry *entry) {
+    munmap(entry->map, entry->map_len);
+    entry->map = NULL;
+}
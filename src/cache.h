@@ -0,0 +1,49 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "flat-ast.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * On disk cache of parsed files, one entry per distinct source. An entry is
+ * the file's FlatAST written out as is, which only refers to itself by index
+ * and offset, so it can be mapped back in anywhere and used in place without
+ * any fixing up. It's keyed by a hash of the source bytes and STIL_VERSION,
+ * so editing a file or changing the compiler just stops old entries from
+ * being found. The source's length is kept alongside and checked too, so a
+ * collision also needs two sources of the same size. Nothing in an entry
+ * depends on any other file, names are stored as this file spelled them.
+ *
+ * Only files that compiled without errors get cached.
+ */
+
+#define CACHE_DEFAULT_DIR ".stil-cache"
+
+typedef struct _CacheKey {
+    uint64_t hash;
+    uint64_t source_len;
+} CacheKey;
+
+typedef struct _CacheEntry {
+    FlatAST ast; // points into map, don't flat_ast_deinit it
+    size_t n_tokens;
+    // whatever compiling the file printed, i.e. warnings
+    const char *diag;
+    size_t diag_len;
+
+    void *map;
+    size_t map_len;
+} CacheEntry;
+
+// $STIL_CACHE_DIR, or CACHE_DEFAULT_DIR in the working directory
+const char *cache_dir();
+CacheKey cache_key(const char *source, size_t len);
+// Maps the entry for key into entry, false if there isn't a usable one
+bool cache_load(const char *dir, CacheKey key, CacheEntry *entry);
+// Failing to write an entry only costs a rebuild next time, so it's quiet
+void cache_store(const char *dir, CacheKey key, const FlatAST *ast,
+                 size_t n_tokens, const char *diag, size_t diag_len);
+void cache_release(CacheEntry *entry);
+
+#endif
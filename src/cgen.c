@@ -0,0 +1,367 @@
+#include "cgen.h"
+#include <spawn.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+typedef struct _CGen {
+    IRModule *module;
+    FILE *out;
+    uint32_t func_idx; // the one being emitted, IR_NO_OWNER for init
+} CGen;
+
+static const char *PRELUDE =
+    "#include <math.h>\n"
+    "#include <stdbool.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    "const char *stil_fault__;\n"
+    "\n"
+    "// INT arithmetic wraps around rather than overflowing\n"
+    "static inline int stil_wrap__(unsigned value) {\n"
+    "    return (int)value;\n"
+    "}\n"
+    "\n"
+    "static inline int stil_pow__(int base, int exp) {\n"
+    "    if(exp < 0) {\n"
+    "        return base == 1 ? 1 : base == -1 ? (exp & 1 ? -1 : 1) : 0;\n"
+    "    }\n"
+    "    unsigned result = 1, b = base;\n"
+    "    for(unsigned e = exp; e; e >>= 1) {\n"
+    "        if(e & 1) {\n"
+    "            result *= b;\n"
+    "        }\n"
+    "        b *= b;\n"
+    "    }\n"
+    "    return stil_wrap__(result);\n"
+    "}\n";
+
+static inline TypeDecl kind_of(CGen *gen, TypeId id) {
+    return type_list_at(gen->module->types, id).kind;
+}
+
+static const char *c_type(CGen *gen, TypeId id) {
+    switch(kind_of(gen, id)) {
+        case TYPE_REAL:
+            return "double";
+        case TYPE_STRING:
+            return "const char *";
+        case TYPE_BOOL:
+            return "bool";
+        default:
+            return "int";
+    }
+}
+
+// type followed by a name, "int x" or "const char *x"
+static void emit_declarator(FILE *out, const char *type) {
+    fprintf(out, "%s%s", type, type[strlen(type) - 1] == '*' ? "" : " ");
+}
+
+// the start of the definition of register reg
+static void emit_def(FILE *out, const char *type, uint32_t reg) {
+    if(type[strlen(type) - 1] == '*') {
+        fprintf(out, "    %sconst r%u = ", type, reg);
+    } else {
+        fprintf(out, "    const %s r%u = ", type, reg);
+    }
+}
+
+static const char *unit_name(CGen *gen, uint32_t func) {
+    return intern_str(ir_function_list_at(gen->module->funcs, func).name);
+}
+
+static void emit_str(FILE *out, const char *s) {
+    fputc('"', out);
+    for(; *s; s++) {
+        unsigned char c = *s;
+        if(c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if(c < ' ' || c >= 0x7f) {
+            // octal escapes stop after three digits, unlike hex ones
+            fprintf(out, "\\%03o", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void emit_real(FILE *out, double value) {
+    char buf[32];
+    snprintf(buf, sizeof buf, "%.17g", value);
+    // keep it a double as far as C is concerned
+    fprintf(out, "%s%s", buf, strpbrk(buf, ".e") ? "" : ".0");
+}
+
+static void emit_field(CGen *gen, uint32_t var) {
+    fprintf(gen->out, "%s_%u",
+            intern_str(ir_var_list_at(gen->module->vars, var).name), var);
+}
+
+static void emit_var(CGen *gen, uint32_t var) {
+    IRVar v = ir_var_list_at(gen->module->vars, var);
+    switch(v.storage) {
+        case IR_GLOBAL:
+            fprintf(gen->out, "stil_globals__.");
+            break;
+        case IR_STATE:
+            if(gen->func_idx == IR_NO_OWNER) {
+                fprintf(gen->out, "stil_%s__state.", unit_name(gen, v.owner));
+            } else {
+                fprintf(gen->out, "self->");
+            }
+            break;
+        case IR_TEMP:
+            break;
+    }
+    emit_field(gen, var);
+}
+
+// Walks the variables of one storage and owner. They're in order of their
+// owners for each storage, so cursor only ever moves forward
+static uint32_t next_var(CGen *gen, uint32_t *cursor, IRStorage storage,
+                         uint32_t owner) {
+    IRVarList *vars = gen->module->vars;
+    for(; *cursor < vars->count; (*cursor)++) {
+        IRVar var = ir_var_list_at(vars, *cursor);
+        if(var.storage != storage) {
+            continue;
+        }
+        if(var.owner != owner) {
+            return UINT32_MAX;
+        }
+        return (*cursor)++;
+    }
+    return UINT32_MAX;
+}
+
+static void emit_fields(CGen *gen, uint32_t *cursor, IRStorage storage,
+                        uint32_t owner) {
+    bool any = false;
+    uint32_t var;
+    while((var = next_var(gen, cursor, storage, owner)) != UINT32_MAX) {
+        TypeId type = ir_var_list_at(gen->module->vars, var).type;
+        fprintf(gen->out, "    ");
+        emit_declarator(gen->out, c_type(gen, type));
+        emit_field(gen, var);
+        fprintf(gen->out, ";\n");
+        any = true;
+    }
+    if(!any && storage != IR_TEMP) {
+        // C wants at least one
+        fprintf(gen->out, "    char unused__;\n");
+    }
+}
+
+static const char *c_operator(IROp op) {
+    switch(op) {
+        case IR_ADD:
+            return "+";
+        case IR_SUB:
+            return "-";
+        case IR_MUL:
+            return "*";
+        case IR_DIV:
+            return "/";
+        case IR_MOD:
+            return "%";
+        case IR_LT:
+            return "<";
+        case IR_LTE:
+            return "<=";
+        case IR_GT:
+            return ">";
+        case IR_GTE:
+            return ">=";
+        case IR_EQ:
+            return "==";
+        case IR_NE:
+            return "!=";
+        case IR_AND:
+            return "&";
+        case IR_OR:
+            return "|";
+        case IR_XOR:
+            return "^";
+        default:
+            return "?";
+    }
+}
+
+static void emit_binary(CGen *gen, const IRInst *inst) {
+    FILE *out = gen->out;
+    TypeDecl kind = kind_of(gen, inst->type);
+    uint32_t a = inst->a, b = inst->b;
+    bool compare = inst->op >= IR_LT && inst->op <= IR_NE;
+
+    if(kind == TYPE_INT && (inst->op == IR_DIV || inst->op == IR_MOD)) {
+        fprintf(out,
+                "    if(r%u == 0) {\n"
+                "        stil_fault__ = \"Division by zero\";\n"
+                "        return false;\n"
+                "    }\n",
+                b);
+    }
+
+    emit_def(out, compare ? "bool" : c_type(gen, inst->type), inst->dst);
+    if(compare && kind == TYPE_STRING) {
+        fprintf(out, "strcmp(r%u, r%u) %s 0", a, b, c_operator(inst->op));
+    } else if(inst->op == IR_POW) {
+        fprintf(out, "%s(r%u, r%u)",
+                kind == TYPE_REAL ? "pow" : "stil_pow__", a, b);
+    } else if(kind == TYPE_INT && inst->op <= IR_MUL) {
+        fprintf(out, "stil_wrap__((unsigned)r%u %s (unsigned)r%u)", a,
+                c_operator(inst->op), b);
+    } else if(kind == TYPE_INT && inst->op == IR_DIV) {
+        // INT_MIN / -1 doesn't fit
+        fprintf(out, "r%u == -1 ? stil_wrap__(0u - (unsigned)r%u) : r%u / r%u",
+                b, a, a, b);
+    } else if(kind == TYPE_INT && inst->op == IR_MOD) {
+        fprintf(out, "r%u == -1 ? 0 : r%u %% r%u", b, a, b);
+    } else {
+        fprintf(out, "r%u %s r%u", a, c_operator(inst->op), b);
+    }
+    fprintf(out, ";\n");
+}
+
+static void emit_inst(CGen *gen, const IRInst *inst) {
+    FILE *out = gen->out;
+    const char *type = c_type(gen, inst->type);
+    switch(inst->op) {
+        case IR_CONST:
+            emit_def(out, type, inst->dst);
+            switch(kind_of(gen, inst->type)) {
+                case TYPE_REAL:
+                    emit_real(out, inst->real_val);
+                    break;
+                case TYPE_STRING:
+                    emit_str(out, inst->str_val);
+                    break;
+                case TYPE_BOOL:
+                    fprintf(out, "%s", inst->bool_val ? "true" : "false");
+                    break;
+                default:
+                    fprintf(out, "%d", inst->int_val);
+                    break;
+            }
+            fprintf(out, ";\n");
+            break;
+        case IR_LOAD: {
+            IRVar var = ir_var_list_at(gen->module->vars, inst->a);
+            emit_def(out, type, inst->dst);
+            // only init can see another function's temps, which haven't
+            // been given anything yet
+            if(var.storage == IR_TEMP && var.owner != gen->func_idx) {
+                fprintf(out, "%s", kind_of(gen, var.type) == TYPE_STRING
+                                       ? "\"\""
+                                       : "0");
+            } else {
+                emit_var(gen, inst->a);
+            }
+            fprintf(out, ";\n");
+            break;
+        }
+        case IR_STORE:
+            fprintf(out, "    ");
+            emit_var(gen, inst->a);
+            fprintf(out, " = r%u;\n", inst->b);
+            break;
+        case IR_ITOF:
+            fprintf(out, "    const double r%u = r%u;\n", inst->dst, inst->a);
+            break;
+        case IR_NEG:
+            if(kind_of(gen, inst->type) == TYPE_REAL) {
+                fprintf(out, "    const double r%u = -r%u;\n", inst->dst,
+                        inst->a);
+            } else {
+                fprintf(out, "    const int r%u = ", inst->dst);
+                fprintf(out, "stil_wrap__(0u - (unsigned)r%u);\n", inst->a);
+            }
+            break;
+        case IR_NOT:
+            fprintf(out, "    const bool r%u = !r%u;\n", inst->dst, inst->a);
+            break;
+        case IR_RET:
+            fprintf(out, "    return true;\n");
+            break;
+        default:
+            emit_binary(gen, inst);
+            break;
+    }
+}
+
+static void emit_body(CGen *gen, IRFunction *func, uint32_t *temps) {
+    if(gen->func_idx != IR_NO_OWNER) {
+        emit_fields(gen, temps, IR_TEMP, gen->func_idx);
+    }
+    IRInst *insts = ir_inst_list_items(func->insts);
+    for(size_t i = 0; i < func->insts->count; i++) {
+        emit_inst(gen, &insts[i]);
+    }
+}
+
+void cgen_emit(IRModule *module, const char *source, FILE *out) {
+    CGen gen = {.module = module, .out = out};
+    IRFunction *funcs = ir_function_list_items(module->funcs);
+    uint32_t n_funcs = module->funcs->count;
+
+    fprintf(out, "// Generated by stil %s from %s, see cgen.h\n", STIL_VERSION,
+            source);
+    fprintf(out, "%s\n", PRELUDE);
+
+    uint32_t cursor = 0;
+    fprintf(out, "struct stil_globals__ {\n");
+    emit_fields(&gen, &cursor, IR_GLOBAL, IR_NO_OWNER);
+    fprintf(out, "} stil_globals__;\n\n");
+
+    cursor = 0;
+    for(uint32_t i = 0; i < n_funcs; i++) {
+        if(funcs[i].state != i) {
+            continue;
+        }
+        const char *name = unit_name(&gen, i);
+        fprintf(out, "struct stil_%s {\n", name);
+        emit_fields(&gen, &cursor, IR_STATE, i);
+        fprintf(out, "} stil_%s__state;\n\n", name);
+    }
+
+    gen.func_idx = IR_NO_OWNER;
+    fprintf(out, "bool stil_init__(void) {\n");
+    emit_body(&gen, &module->init, NULL);
+    fprintf(out, "}\n");
+
+    uint32_t temps = 0;
+    for(uint32_t i = 0; i < n_funcs; i++) {
+        gen.func_idx = i;
+        fprintf(out, "\nbool stil_%s(struct stil_%s *self) {\n",
+                unit_name(&gen, i), unit_name(&gen, funcs[i].state));
+        // not every function touches its state
+        fprintf(out, "    (void)self;\n");
+        emit_body(&gen, &funcs[i], &temps);
+        fprintf(out, "}\n");
+    }
+}
+
+bool cgen_build_shared(const char *c_path, const char *so_path) {
+    const char *cc = getenv("CC");
+    if(!cc || !*cc) {
+        cc = "cc";
+    }
+    char *argv[] = {
+        (char *)cc, "-O2",          "-shared", "-fPIC", "-o",
+        (char *)so_path, (char *)c_path, "-lm", NULL,
+    };
+
+    pid_t pid;
+    if(posix_spawnp(&pid, cc, NULL, NULL, argv, environ) != 0) {
+        stil_warn("Couldn't run %s", cc);
+        return false;
+    }
+    int status;
+    if(waitpid(pid, &status, 0) < 0) {
+        return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
@@ -0,0 +1,33 @@
+#ifndef CGEN_H
+#define CGEN_H
+
+#include "ir.h"
+#include <stdio.h>
+
+/*
+ * Turns a module into plain C for the system compiler to make a shared
+ * object of. For every PROGRAM (or ACTION without one) there's
+ *
+ *   struct stil_NAME         its state, one field per variable
+ *   stil_NAME__state         an instance of it
+ *   bool stil_NAME(struct stil_NAME *self)
+ *
+ * where NAME is the ST name in upper case, and each ACTION is a function
+ * like that too, on the state of its PROGRAM. Globals are fields of
+ * stil_globals__. stil_init__() has to be called once before anything
+ * else. Everything returns false if it stopped on a fault, which it leaves
+ * in stil_fault__.
+ *
+ * ST names can't have two underscores in a row, resolve_comp_unit rejects
+ * them, so nothing generated from one clashes with the names ending in __.
+ * Fields are named after the variable and its index in the module, since a
+ * C keyword is a fine name in ST and an ACTION can shadow its PROGRAM's
+ * variables.
+ */
+void cgen_emit(IRModule *module, const char *source, FILE *out);
+
+// Compiles c_path into the shared object so_path with $CC, or cc if it
+// isn't set. false if the compiler couldn't be run or failed
+bool cgen_build_shared(const char *c_path, const char *so_path);
+
+#endif
@@ -0,0 +1,337 @@
+#define _GNU_SOURCE
+#include "driver.h"
+#include "arena.h"
+#include "cache.h"
+#include "flat-ast.h"
+#include "ir.h"
+#include "lexer.h"
+#include "parser.h"
+#include "pool.h"
+#include "sema.h"
+#include "vec.h"
+#include <dirent.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+
+VEC_DEFINE(PathList, path_list, char *)
+
+typedef struct _BuildJob {
+    const char *path;
+    size_t size;
+    const DriverOptions *opts;
+
+    Arena arena;
+    Lexer *lexer;
+    TokenBuffer *tokens;
+    CompilationUnit *comp_unit;
+    FlatAST *flat_ast;
+    IRModule *ir;
+    // everything the job had to say, printed once it's this job's turn
+    char *diag;
+    size_t diag_len;
+    int n_errors;
+    size_t n_tokens;
+    // on a hit the tree comes out of here and nothing gets parsed
+    CacheEntry cached;
+    bool cache_hit;
+
+    bool done;
+    pthread_mutex_t *lock;
+    pthread_cond_t *finished;
+} BuildJob;
+
+static double now_secs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool is_st_file(const char *name) {
+    size_t len = strlen(name);
+    return len > 3 && strcasecmp(name + len - 3, ".st") == 0;
+}
+
+static char *join_path(const char *dir, size_t dir_len, const char *name) {
+    size_t name_len = strlen(name);
+    char *path = stil_malloc(dir_len + name_len + 2);
+    memcpy(path, dir, dir_len);
+    path[dir_len] = '/';
+    memcpy(path + dir_len + 1, name, name_len + 1);
+    return path;
+}
+
+static char *dup_path(const char *path) {
+    size_t len = strlen(path);
+    char *dup = stil_malloc(len + 1);
+    memcpy(dup, path, len + 1);
+    return dup;
+}
+
+static void add_input(PathList *paths, const char *input);
+
+// .st files anywhere under dir, in name order so builds are repeatable.
+// Dot files and directories are left alone
+static void add_dir(PathList *paths, const char *dir) {
+    struct dirent **entries;
+    int n = scandir(dir, &entries, NULL, alphasort);
+    if(n < 0) {
+        stil_fatal("Couldn't read directory %s", dir);
+    }
+
+    for(int i = 0; i < n; i++) {
+        const char *name = entries[i]->d_name;
+        if(name[0] != '.') {
+            char *path = join_path(dir, strlen(dir), name);
+            struct stat st;
+            if(stat(path, &st) == 0 &&
+               (S_ISDIR(st.st_mode) ||
+                (S_ISREG(st.st_mode) && is_st_file(name)))) {
+                add_input(paths, path);
+            }
+            stil_free(path);
+        }
+        free(entries[i]);
+    }
+    free(entries);
+}
+
+static void add_manifest(PathList *paths, const char *manifest) {
+    FILE *f = fopen(manifest, "r");
+    if(!f) {
+        stil_fatal("Couldn't open manifest %s", manifest);
+    }
+    const char *slash = strrchr(manifest, '/');
+    size_t dir_len = slash ? (size_t)(slash - manifest) : 0;
+
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    while((len = getline(&line, &cap, f)) >= 0) {
+        char *start = line;
+        char *end = line + len;
+        while(start < end && (*start == ' ' || *start == '\t')) {
+            start++;
+        }
+        while(end > start && (end[-1] == '\n' || end[-1] == '\r' ||
+                              end[-1] == ' ' || end[-1] == '\t')) {
+            end--;
+        }
+        *end = '\0';
+        if(start == end || *start == '#') {
+            continue;
+        }
+
+        if(*start == '/' || !slash) {
+            add_input(paths, start);
+        } else {
+            char *path = join_path(manifest, dir_len, start);
+            add_input(paths, path);
+            stil_free(path);
+        }
+    }
+
+    free(line);
+    fclose(f);
+}
+
+static void add_input(PathList *paths, const char *input) {
+    if(input[0] == '@') {
+        add_manifest(paths, input + 1);
+        return;
+    }
+
+    struct stat st;
+    if(stat(input, &st) < 0) {
+        stil_fatal("Couldn't find %s", input);
+    }
+    if(S_ISDIR(st.st_mode)) {
+        add_dir(paths, input);
+    } else {
+        path_list_push(paths, dup_path(input));
+    }
+}
+
+bool driver_is_project(const char *input) {
+    struct stat st;
+    return input[0] == '@' || (stat(input, &st) == 0 && S_ISDIR(st.st_mode));
+}
+
+static void finish_job(BuildJob *job);
+
+static void build_job_run(void *arg) {
+    BuildJob *job = arg;
+    const DriverOptions *opts = job->opts;
+
+    job->arena = arena_init(COMPILATION_ARENA_SIZE);
+    job->lexer = lexer_init(job->path, &job->arena);
+
+    // there's no IR in the cache, only trees
+    bool use_cache = opts->cache_dir && !opts->lex && !opts->ir;
+    CacheKey key = {0};
+    if(use_cache) {
+        key = cache_key(job->lexer->whole, job->lexer->source_len);
+        job->cache_hit = cache_load(opts->cache_dir, key, &job->cached);
+        if(job->cache_hit) {
+            job->n_tokens = job->cached.n_tokens;
+            finish_job(job);
+            return;
+        }
+    }
+
+    job->lexer->diag = open_memstream(&job->diag, &job->diag_len);
+    if(!job->lexer->diag) {
+        stil_fatal("Couldn't buffer errors for %s", job->path);
+    }
+
+    job->tokens = lexer_tokenize_all(job->lexer);
+    if(!opts->lex) {
+        Parser *parser = parser_init(job->lexer, job->tokens, &job->arena);
+        parser->max_errors = opts->max_errors;
+        job->comp_unit = parse_compilation_unit(parser);
+        if(job->lexer->n_errors == 0) {
+            sema_comp_unit(job->comp_unit, job->lexer, &job->arena,
+                           opts->max_errors);
+        }
+        if(opts->ir && job->lexer->n_errors == 0) {
+            job->ir = ir_lower(job->comp_unit, &job->arena);
+        }
+        if((opts->flat || use_cache) && job->lexer->n_errors == 0) {
+            job->flat_ast = flat_ast_from_comp_unit(job->comp_unit, job->lexer);
+        }
+    }
+    job->n_errors = job->lexer->n_errors;
+    job->n_tokens = job->tokens->count;
+    fclose(job->lexer->diag);
+    job->lexer->diag = stdout;
+
+    if(use_cache && job->flat_ast) {
+        cache_store(opts->cache_dir, key, job->flat_ast, job->n_tokens,
+                    job->diag, job->diag_len);
+    }
+    finish_job(job);
+}
+
+static void finish_job(BuildJob *job) {
+    pthread_mutex_lock(job->lock);
+    job->done = true;
+    pthread_cond_broadcast(job->finished);
+    pthread_mutex_unlock(job->lock);
+}
+
+// biggest first
+static int by_size(const void *a, const void *b) {
+    const BuildJob *x = *(BuildJob *const *)a;
+    const BuildJob *y = *(BuildJob *const *)b;
+    return (x->size < y->size) - (x->size > y->size);
+}
+
+size_t driver_build(const char **inputs, size_t n_inputs,
+                    const DriverOptions *opts) {
+    double start = now_secs();
+
+    PathList *paths = path_list_init(NULL);
+    for(size_t i = 0; i < n_inputs; i++) {
+        add_input(paths, inputs[i]);
+    }
+    size_t n_jobs = paths->count;
+    if(n_jobs == 0) {
+        stil_fatal("No source files to compile");
+    }
+
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t finished = PTHREAD_COND_INITIALIZER;
+    BuildJob *jobs = stil_calloc(n_jobs, sizeof *jobs);
+    BuildJob **order = stil_malloc(n_jobs * sizeof *order);
+    for(size_t i = 0; i < n_jobs; i++) {
+        struct stat st;
+        jobs[i] = (BuildJob){
+            .path = path_list_at(paths, i),
+            .size = stat(path_list_at(paths, i), &st) == 0 ? st.st_size : 0,
+            .opts = opts,
+            .lock = &lock,
+            .finished = &finished,
+        };
+        order[i] = &jobs[i];
+    }
+
+    // The build takes at least as long as the biggest file, so the biggest
+    // ones go first. Outside submissions are taken in order, so every
+    // worker that frees up picks the biggest file nobody has started yet
+    qsort(order, n_jobs, sizeof *order, by_size);
+    Pool *pool = pool_init(opts->n_threads < (int)n_jobs ? opts->n_threads
+                                                          : (int)n_jobs);
+    for(size_t i = 0; i < n_jobs; i++) {
+        pool_submit(pool, build_job_run, order[i]);
+    }
+
+    // print each file as soon as it and everything before it is done
+    size_t n_failed = 0;
+    size_t n_tokens = 0;
+    size_t arena_bytes = 0;
+    size_t n_cache_hits = 0;
+    for(size_t i = 0; i < n_jobs; i++) {
+        BuildJob *job = &jobs[i];
+        pthread_mutex_lock(&lock);
+        while(!job->done) {
+            pthread_cond_wait(&finished, &lock);
+        }
+        pthread_mutex_unlock(&lock);
+
+        if(job->cache_hit) {
+            fwrite(job->cached.diag, 1, job->cached.diag_len, stdout);
+            n_cache_hits++;
+        } else {
+            fwrite(job->diag, 1, job->diag_len, stdout);
+            free(job->diag);
+        }
+        if(job->n_errors > 0) {
+            stil_warn("Couldn't compile %s due to %d errors.", job->path,
+                      job->n_errors);
+            n_failed++;
+        } else if(opts->dump && !opts->lex) {
+            stil_info("%s", job->path);
+            if(job->ir) {
+                ir_dump(job->ir);
+            } else if(job->cache_hit) {
+                flat_ast_dump(&job->cached.ast);
+            } else if(job->flat_ast) {
+                flat_ast_dump(job->flat_ast);
+            } else {
+                comp_unit_dump(job->comp_unit, job->lexer);
+            }
+        }
+
+        n_tokens += job->n_tokens;
+        arena_bytes += job->arena.offset;
+        if(job->flat_ast) {
+            flat_ast_deinit(job->flat_ast);
+        }
+        if(job->cache_hit) {
+            cache_release(&job->cached);
+        } else {
+            token_buffer_deinit(job->tokens);
+        }
+        lexer_deinit(job->lexer);
+        arena_deinit(&job->arena);
+        stil_free((char *)job->path);
+    }
+    pool_deinit(pool);
+
+    printf("Build time: %f seconds (%zu files, %zu tokens)\n",
+           now_secs() - start, n_jobs, n_tokens);
+    if(opts->stats) {
+        printf("stat files %zu\n", n_jobs);
+        printf("stat tokens %zu\n", n_tokens);
+        printf("stat allocs %zu\n", stil_alloc_count());
+        printf("stat arena_bytes %zu\n", arena_bytes);
+        printf("stat interned %zu\n", intern_count());
+        printf("stat cache_hits %zu\n", n_cache_hits);
+    }
+
+    stil_free(order);
+    stil_free(jobs);
+    path_list_deinit(paths);
+    return n_failed;
+}
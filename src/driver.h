@@ -0,0 +1,43 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Every file's tree lives in one of these. It's only address space until it
+// gets used, so it's sized for far bigger inputs than we'll ever see rather
+// than being guessed from the file
+#define COMPILATION_ARENA_SIZE ((size_t)4 * 1024 * 1024 * 1024)
+
+typedef struct _DriverOptions {
+    int n_threads;
+    bool lex;  // stop after lexing
+    bool dump; // print each file's tree
+    bool flat; // go through the flat tree, see flat-ast.h
+    bool ir;   // print each file's IR instead, see ir.h
+    bool stats;
+    int max_errors; // per file
+    // where to look for and keep parsed files, NULL to always parse them.
+    // See cache.h
+    const char *cache_dir;
+} DriverOptions;
+
+// Whether input has to go through driver_build, i.e. it's a directory or
+// an @manifest rather than a single source file
+bool driver_is_project(const char *input);
+
+/*
+ * Compiles everything the inputs name, at most n_threads files at a time.
+ * An input is a source file, a directory that gets searched for .st files,
+ * or @file naming a manifest with one input per line. Blank lines and lines
+ * starting with # are skipped, and relative paths in a manifest are taken
+ * relative to the manifest.
+ *
+ * Files are compiled biggest first, but whatever they print comes out in
+ * input order, one file after the other. Returns the number of files that
+ * failed to compile.
+ */
+size_t driver_build(const char **inputs, size_t n_inputs,
+                    const DriverOptions *opts);
+
+#endif
@@ -0,0 +1,493 @@
+#include "flat-ast.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define FLAT_INIT_CAP 64
+
+static FlatRef push_node(FlatAST *ast, NodeKind kind, uint32_t a,
+                         uint32_t b) {
+    if(ast->n_nodes == ast->nodes_cap) {
+        ast->nodes_cap *= 2;
+        ast->kinds = stil_realloc(ast->kinds, ast->nodes_cap);
+        ast->payloads = stil_realloc(ast->payloads,
+                                     ast->nodes_cap * sizeof(FlatPayload));
+    }
+    ast->kinds[ast->n_nodes] = (uint8_t)kind;
+    ast->payloads[ast->n_nodes] = (FlatPayload){a, b};
+    return ast->n_nodes++;
+}
+
+// hands back the index of n fresh slots, which get filled in afterwards.
+// Only ever hold on to the index, extra moves when it grows
+static uint32_t reserve_extra(FlatAST *ast, uint32_t n) {
+    if(ast->n_extra + n > ast->extra_cap) {
+        while(ast->n_extra + n > ast->extra_cap) {
+            ast->extra_cap *= 2;
+        }
+        ast->extra =
+            stil_realloc(ast->extra, ast->extra_cap * sizeof(uint32_t));
+    }
+    uint32_t at = ast->n_extra;
+    ast->n_extra += n;
+    return at;
+}
+
+// s doesn't have to be terminated, it gets a NUL after len bytes
+static FlatStr push_str(FlatAST *ast, const char *s, size_t n) {
+    uint32_t len = n + 1;
+    if(ast->strings_len + len > ast->strings_cap) {
+        while(ast->strings_len + len > ast->strings_cap) {
+            ast->strings_cap *= 2;
+        }
+        ast->strings = stil_realloc(ast->strings, ast->strings_cap);
+    }
+    memcpy(ast->strings + ast->strings_len, s, n);
+    ast->strings[ast->strings_len + n] = '\0';
+    FlatStr at = ast->strings_len;
+    ast->strings_len += len;
+    return at;
+}
+
+static FlatStr push_symbol(FlatAST *ast, const Lexer *lexer,
+                           const Symbol *symbol) {
+    StrView name = symbol_spelling(lexer, symbol);
+    return push_str(ast, name.ptr, name.len);
+}
+
+static FlatRef flatten_node(FlatAST *ast, const Lexer *lexer, ASTNode *node);
+
+static FlatRef flatten_var_decl(FlatAST *ast, const Lexer *lexer,
+                                VarDeclaration *decl) {
+    uint32_t n = decl->labels->count;
+    uint32_t at = reserve_extra(ast, 2 + n);
+    ast->extra[at] = decl->type;
+    ast->extra[at + 1] = n;
+    for(uint32_t i = 0; i < n; i++) {
+        FlatStr label =
+            push_symbol(ast, lexer, symbol_list_at(decl->labels, i));
+        ast->extra[at + 2 + i] = label;
+    }
+
+    FlatRef value = flatten_node(ast, lexer, decl->value);
+    return push_node(ast, ASNTNODE_VAR_DECLARATION, value, at);
+}
+
+static FlatRef flatten_var_block(FlatAST *ast, const Lexer *lexer,
+                                 VarBlock *block) {
+    uint32_t n = block->var_decls->count;
+    uint32_t at = reserve_extra(ast, 1 + n);
+    ast->extra[at] = n;
+    for(uint32_t i = 0; i < n; i++) {
+        FlatRef decl =
+            flatten_node(ast, lexer, astnode_list_at(block->var_decls, i));
+        ast->extra[at + 1 + i] = decl;
+    }
+    return push_node(ast, ASNTNODE_VAR_DECLARATION_BLOCK, block->block_type,
+                     at);
+}
+
+static inline bool is_expr(ASTNode *node) {
+    return node->kind == ASTNODE_BINARY_EXPR ||
+           node->kind == ASTNODE_UNARY_EXPR;
+}
+
+typedef struct _ExprFrame {
+    ASTNode *node;
+    bool children_done;
+} ExprFrame;
+
+/*
+ * Expressions can be nested as deep as the parser lets them, so they're
+ * walked with explicit stacks instead of recursion. Every node is pushed
+ * after its children, rhs last, which is what flat_rhs relies on
+ */
+static FlatRef flatten_expr(FlatAST *ast, const Lexer *lexer, ASTNode *root) {
+    ExprFrame *work = NULL;
+    FlatRef *done = NULL;
+    size_t n_work = 0, work_cap = 0;
+    size_t n_done = 0, done_cap = 0;
+
+#define PUSH(arr, n, cap, val)                                                 \
+    do {                                                                       \
+        if(n == cap) {                                                         \
+            cap = cap ? cap * 2 : FLAT_INIT_CAP;                               \
+            arr = stil_realloc(arr, cap * sizeof *arr);                        \
+        }                                                                      \
+        arr[n++] = val;                                                        \
+    } while(0)
+
+    PUSH(work, n_work, work_cap, ((ExprFrame){root, false}));
+    while(n_work > 0) {
+        ExprFrame frame = work[--n_work];
+        ASTNode *node = frame.node;
+
+        if(!is_expr(node)) {
+            PUSH(done, n_done, done_cap, flatten_node(ast, lexer, node));
+            continue;
+        }
+
+        if(!frame.children_done) {
+            PUSH(work, n_work, work_cap, ((ExprFrame){node, true}));
+            if(node->kind == ASTNODE_BINARY_EXPR) {
+                PUSH(work, n_work, work_cap,
+                     ((ExprFrame){node->binary_expr.rhs, false}));
+                PUSH(work, n_work, work_cap,
+                     ((ExprFrame){node->binary_expr.lhs, false}));
+            } else {
+                PUSH(work, n_work, work_cap,
+                     ((ExprFrame){node->unary_expr.operand, false}));
+            }
+            continue;
+        }
+
+        FlatRef ref;
+        if(node->kind == ASTNODE_BINARY_EXPR) {
+            n_done--; // the rhs, found again through flat_rhs
+            FlatRef lhs = done[--n_done];
+            ref = push_node(ast, ASTNODE_BINARY_EXPR, node->binary_expr.op,
+                            lhs);
+        } else {
+            FlatRef operand = done[--n_done];
+            ref = push_node(ast, ASTNODE_UNARY_EXPR, node->unary_expr.op,
+                            operand);
+        }
+        PUSH(done, n_done, done_cap, ref);
+    }
+
+#undef PUSH
+
+    FlatRef ref = done[0];
+    stil_free(work);
+    stil_free(done);
+    return ref;
+}
+
+static FlatRef flatten_node(FlatAST *ast, const Lexer *lexer, ASTNode *node) {
+    if(!node) {
+        return FLAT_NONE;
+    }
+    if(is_expr(node)) {
+        return flatten_expr(ast, lexer, node);
+    }
+
+    switch(node->kind) {
+        case ASNTNODE_VAR_DECLARATION_BLOCK:
+            return flatten_var_block(ast, lexer, &node->var_block);
+        case ASNTNODE_VAR_DECLARATION:
+            return flatten_var_decl(ast, lexer, &node->var_decl);
+        case ASTNODE_ASSIGNMENT_STMT:
+            {
+                FlatStr name = push_symbol(ast, lexer, node->asgmt.name);
+                FlatRef value = flatten_node(ast, lexer, node->asgmt.value);
+                return push_node(ast, ASTNODE_ASSIGNMENT_STMT, name, value);
+            }
+        case ASTNODE_INT_LITERAL:
+            return push_node(ast, ASTNODE_INT_LITERAL,
+                             (uint32_t)node->int_literal.int_val, 0);
+        case ASTNODE_REAL_LITERAL:
+            {
+                uint32_t bits[2];
+                memcpy(bits, &node->real_literal.real_val, sizeof bits);
+                return push_node(ast, ASTNODE_REAL_LITERAL, bits[0], bits[1]);
+            }
+        case ASTNODE_STR_LITERAL:
+            return push_node(ast, ASTNODE_STR_LITERAL,
+                             push_str(ast, node->str_literal.str_val,
+                                      strlen(node->str_literal.str_val)), 0);
+        case ASTNODE_BOOL_LITERAL:
+            return push_node(ast, ASTNODE_BOOL_LITERAL,
+                             node->bool_literal.bool_val, 0);
+        case ASTNODE_SYMBOL:
+            return push_node(ast, ASTNODE_SYMBOL,
+                             push_symbol(ast, lexer, &node->symbol), 0);
+        default:
+            // nothing the parser makes yet, and nothing the dump would show
+            return FLAT_NONE;
+    }
+}
+
+static FlatRef flatten_st_unit(FlatAST *ast, const Lexer *lexer, STUnit *unit) {
+    uint32_t n_blocks = unit->variable_blocks->count;
+    uint32_t n_stmts = unit->statements->count;
+    uint32_t at = reserve_extra(ast, 3 + n_blocks + n_stmts);
+    ast->extra[at] = unit->unit_type;
+    ast->extra[at + 1] = n_blocks;
+    ast->extra[at + 2] = n_stmts;
+
+    FlatStr name = push_symbol(ast, lexer, unit->name);
+    for(uint32_t i = 0; i < n_blocks; i++) {
+        FlatRef block =
+            flatten_node(ast, lexer, astnode_list_at(unit->variable_blocks, i));
+        ast->extra[at + 3 + i] = block;
+    }
+    for(uint32_t i = 0; i < n_stmts; i++) {
+        FlatRef stmt =
+            flatten_node(ast, lexer, astnode_list_at(unit->statements, i));
+        ast->extra[at + 3 + n_blocks + i] = stmt;
+    }
+    return push_node(ast, ASTNODE_PROGRAM, name, at);
+}
+
+FlatAST *flat_ast_from_comp_unit(CompilationUnit *comp_unit,
+                                 const Lexer *lexer) {
+    FlatAST *ast = stil_malloc(sizeof *ast);
+    ast->nodes_cap = FLAT_INIT_CAP;
+    ast->kinds = stil_malloc(ast->nodes_cap);
+    ast->payloads = stil_malloc(ast->nodes_cap * sizeof(FlatPayload));
+    ast->n_nodes = 0;
+    ast->extra_cap = FLAT_INIT_CAP;
+    ast->extra = stil_malloc(ast->extra_cap * sizeof(uint32_t));
+    ast->n_extra = 0;
+    ast->strings_cap = FLAT_INIT_CAP;
+    ast->strings = stil_malloc(ast->strings_cap);
+    ast->strings_len = 0;
+
+    uint32_t n = comp_unit->st_units->count;
+    ast->root = reserve_extra(ast, 1 + n);
+    ast->extra[ast->root] = n;
+    for(uint32_t i = 0; i < n; i++) {
+        FlatRef unit =
+            flatten_st_unit(ast, lexer,
+                            st_unit_list_at(comp_unit->st_units, i));
+        ast->extra[ast->root + 1 + i] = unit;
+    }
+
+    return ast;
+}
+
+void flat_ast_deinit(FlatAST *ast) {
+    stil_free(ast->kinds);
+    stil_free(ast->payloads);
+    stil_free(ast->extra);
+    stil_free(ast->strings);
+    stil_free(ast);
+}
+
+size_t flat_ast_bytes(const FlatAST *ast) {
+    return ast->n_nodes * (sizeof(uint8_t) + sizeof(FlatPayload)) +
+           ast->n_extra * sizeof(uint32_t) + ast->strings_len;
+}
+
+static void dump_node(const FlatAST *ast, FlatRef ref, size_t indent);
+
+static void dump_var_decl(const FlatAST *ast, FlatPayload p, size_t indent) {
+    const uint32_t *extra = ast->extra + p.b;
+    INDENTED(indent, "VAR DECLARATION:");
+    INDENTED_NONEW(indent + 1, "Symbols: ");
+    for(uint32_t i = 0; i < extra[1]; i++) {
+        printf(i == 0 ? "%s" : ", %s", flat_str(ast, extra[2 + i]));
+    }
+    printf("\n");
+    INDENTED(indent + 1, "TYPE: %s", type_dbg(extra[0]));
+    if(p.a != FLAT_NONE) {
+        INDENTED(indent + 1, "VALUE:");
+        dump_node(ast, p.a, indent + 2);
+    }
+}
+
+static void dump_node(const FlatAST *ast, FlatRef ref, size_t indent) {
+    if(ref == FLAT_NONE) {
+        return;
+    }
+
+    FlatPayload p = ast->payloads[ref];
+    switch(flat_kind(ast, ref)) {
+        case ASNTNODE_VAR_DECLARATION_BLOCK:
+            {
+                const uint32_t *extra = ast->extra + p.b;
+                INDENTED(indent, "VAR DECLARATION BLOCK (%s):",
+                         var_block_type_dbg(p.a));
+                for(uint32_t i = 0; i < extra[0]; i++) {
+                    dump_var_decl(ast, ast->payloads[extra[1 + i]],
+                                  indent + 1);
+                }
+                break;
+            }
+        case ASNTNODE_VAR_DECLARATION:
+            dump_var_decl(ast, p, indent);
+            break;
+        case ASTNODE_ASSIGNMENT_STMT:
+            INDENTED(indent, "ASSIGNMENT:");
+            INDENTED(indent + 1, "LHS: %s", flat_str(ast, p.a));
+            INDENTED(indent + 1, "RHS:");
+            dump_node(ast, p.b, indent + 2);
+            break;
+        case ASTNODE_INT_LITERAL:
+            INDENTED(indent, "INT LITERAL: %d", (int)p.a);
+            break;
+        case ASTNODE_REAL_LITERAL:
+            {
+                double val;
+                memcpy(&val, &p, sizeof val);
+                INDENTED(indent, "REAL LITERAL: %f", val);
+                break;
+            }
+        case ASTNODE_STR_LITERAL:
+            INDENTED(indent, "STR LITERAL: %s", flat_str(ast, p.a));
+            break;
+        case ASTNODE_BOOL_LITERAL:
+            INDENTED(indent, "BOOL LITERAL: %s", p.a ? "TRUE" : "FALSE");
+            break;
+        case ASTNODE_SYMBOL:
+            INDENTED(indent, "SYMBOL: %s", flat_str(ast, p.a));
+            break;
+        case ASTNODE_BINARY_EXPR:
+            INDENTED(indent, "BINARY EXPR (%s):", infix_op_dbg(p.a));
+            INDENTED(indent + 1, "LHS:");
+            dump_node(ast, p.b, indent + 2);
+            INDENTED(indent + 1, "RHS:");
+            dump_node(ast, flat_rhs(ref), indent + 2);
+            break;
+        case ASTNODE_UNARY_EXPR:
+            INDENTED(indent, "UNARY EXPR (%s):", prefix_op_dbg(p.a));
+            dump_node(ast, p.b, indent + 1);
+            break;
+        default:
+            break;
+    }
+}
+
+static void dump_st_unit(const FlatAST *ast, FlatRef ref, size_t indent) {
+    FlatPayload p = ast->payloads[ref];
+    const uint32_t *extra = ast->extra + p.b;
+    uint32_t n_blocks = extra[1];
+    uint32_t n_stmts = extra[2];
+
+    INDENTED(indent, "%s:", st_unit_type_dbg(extra[0]));
+    INDENTED(indent + 1, "NAME: %s", flat_str(ast, p.a));
+
+    if(n_blocks > 0) {
+        INDENTED(indent + 1, "VARIABLE_DECLARATIONS:");
+        for(uint32_t i = 0; i < n_blocks; i++) {
+            dump_node(ast, extra[3 + i], indent + 2);
+        }
+    }
+
+    if(n_stmts > 0) {
+        INDENTED(indent + 1, "BODY:");
+        for(uint32_t i = 0; i < n_stmts; i++) {
+            dump_node(ast, extra[3 + n_blocks + i], indent + 2);
+        }
+    }
+}
+
+void flat_ast_dump(const FlatAST *ast) {
+    stil_info("======AST======");
+    const uint32_t *units = ast->extra + ast->root;
+    for(uint32_t i = 0; i < units[0]; i++) {
+        dump_st_unit(ast, units[1 + i], 0);
+    }
+}
+
+// n words of extra starting at at
+static inline bool extra_fits(const FlatAST *ast, uint64_t at, uint64_t n) {
+    return at <= ast->n_extra && n <= ast->n_extra - at;
+}
+
+static inline bool str_ok(const FlatAST *ast, FlatStr str) {
+    return str < ast->strings_len;
+}
+
+// a child of node ref, which has to come before it
+static inline bool child_ok(FlatRef child, FlatRef ref) {
+    return child == FLAT_NONE || child < ref;
+}
+
+// refs that all have to be children of ref
+static bool children_ok(const uint32_t *refs, uint32_t n, FlatRef ref) {
+    for(uint32_t i = 0; i < n; i++) {
+        if(!child_ok(refs[i], ref)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool node_ok(const FlatAST *ast, FlatRef ref) {
+    FlatPayload p = ast->payloads[ref];
+    const uint32_t *extra = ast->extra + p.b;
+    switch(flat_kind(ast, ref)) {
+        case ASTNODE_PROGRAM:
+            {
+                if(!str_ok(ast, p.a) || !extra_fits(ast, p.b, 3) ||
+                   extra[0] > NO_STUNIT) {
+                    return false;
+                }
+                uint64_t n = (uint64_t)extra[1] + extra[2];
+                return extra_fits(ast, p.b + 3ull, n) &&
+                       children_ok(extra + 3, n, ref);
+            }
+        case ASNTNODE_VAR_DECLARATION_BLOCK:
+            {
+                if(p.a > NO_VARBLOCK || !extra_fits(ast, p.b, 1) ||
+                   !extra_fits(ast, p.b + 1ull, extra[0])) {
+                    return false;
+                }
+                // the dump goes straight to their payloads
+                for(uint32_t i = 0; i < extra[0]; i++) {
+                    FlatRef decl = extra[1 + i];
+                    if(decl >= ref ||
+                       flat_kind(ast, decl) != ASNTNODE_VAR_DECLARATION) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        case ASNTNODE_VAR_DECLARATION:
+            {
+                if(!child_ok(p.a, ref) || !extra_fits(ast, p.b, 2) ||
+                   extra[0] > NO_TYPE ||
+                   !extra_fits(ast, p.b + 2ull, extra[1])) {
+                    return false;
+                }
+                for(uint32_t i = 0; i < extra[1]; i++) {
+                    if(!str_ok(ast, extra[2 + i])) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        case ASTNODE_ASSIGNMENT_STMT:
+            return str_ok(ast, p.a) && child_ok(p.b, ref);
+        case ASTNODE_STR_LITERAL:
+        case ASTNODE_SYMBOL:
+            return str_ok(ast, p.a);
+        case ASTNODE_INT_LITERAL:
+        case ASTNODE_REAL_LITERAL:
+        case ASTNODE_BOOL_LITERAL:
+            return true;
+        case ASTNODE_BINARY_EXPR:
+            // the rhs is the node right before
+            return p.a < NO_INFIX && ref > 0 && child_ok(p.b, ref);
+        case ASTNODE_UNARY_EXPR:
+            return p.a < NO_PREFIX && child_ok(p.b, ref);
+        default:
+            return false;
+    }
+}
+
+bool flat_ast_check(const FlatAST *ast) {
+    if(ast->strings_len > 0 && ast->strings[ast->strings_len - 1] != '\0') {
+        return false;
+    }
+    for(FlatRef ref = 0; ref < ast->n_nodes; ref++) {
+        if(!node_ok(ast, ref)) {
+            return false;
+        }
+    }
+
+    if(!extra_fits(ast, ast->root, 1)) {
+        return false;
+    }
+    const uint32_t *units = ast->extra + ast->root;
+    if(!extra_fits(ast, ast->root + 1ull, units[0])) {
+        return false;
+    }
+    for(uint32_t i = 0; i < units[0]; i++) {
+        if(units[1 + i] >= ast->n_nodes ||
+           flat_kind(ast, units[1 + i]) != ASTNODE_PROGRAM) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef FLAT_AST_H
+#define FLAT_AST_H
+
+#include "ast.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * The same tree as CompilationUnit, packed into a few flat arrays instead of
+ * pointers. A node is a 1 byte kind and an 8 byte payload at the same index
+ * of kinds and payloads, and nodes refer to each other by index. Anything
+ * with a variable number of children keeps them in extra, and names and
+ * string literals are offsets into one NUL separated strings buffer.
+ *
+ * Payloads by kind:
+ *   ASTNODE_PROGRAM (any st unit)  a = name          b = extra: unit type,
+ *                                  n blocks, n statements, blocks...,
+ *                                  statements...
+ *   ASNTNODE_VAR_DECLARATION_BLOCK a = block type    b = extra: n, decls...
+ *   ASNTNODE_VAR_DECLARATION       a = value         b = extra: type,
+ *                                  n labels, labels...
+ *   ASTNODE_ASSIGNMENT_STMT        a = name          b = value
+ *   ASTNODE_INT_LITERAL            a = value
+ *   ASTNODE_REAL_LITERAL           a and b hold the bits of the double
+ *   ASTNODE_STR_LITERAL            a = string
+ *   ASTNODE_BOOL_LITERAL           a = 0 or 1
+ *   ASTNODE_SYMBOL                 a = name
+ *   ASTNODE_BINARY_EXPR            a = operator      b = lhs
+ *   ASTNODE_UNARY_EXPR             a = operator      b = operand
+ *
+ * Expression nodes always come right after their last child, so the rhs of
+ * a binary expression isn't stored, it's the node just before it.
+ *
+ * The top level units sit in extra as well, starting at root: n, units...
+ */
+
+typedef uint32_t FlatRef; // index into kinds/payloads
+typedef uint32_t FlatStr; // offset into strings
+
+#define FLAT_NONE UINT32_MAX
+
+typedef struct _FlatPayload {
+    uint32_t a, b;
+} FlatPayload;
+
+typedef struct _FlatAST {
+    uint8_t *kinds;
+    FlatPayload *payloads;
+    uint32_t n_nodes, nodes_cap;
+
+    uint32_t *extra;
+    uint32_t n_extra, extra_cap;
+
+    char *strings;
+    uint32_t strings_len, strings_cap;
+
+    uint32_t root;
+} FlatAST;
+
+// lexer is the one comp_unit was parsed from, names are spelled out of it
+FlatAST *flat_ast_from_comp_unit(CompilationUnit *comp_unit,
+                                 const Lexer *lexer);
+void flat_ast_deinit(FlatAST *ast);
+// bytes taken up by the node, extra and string arrays
+size_t flat_ast_bytes(const FlatAST *ast);
+// prints exactly what comp_unit_dump prints for the same tree
+void flat_ast_dump(const FlatAST *ast);
+// Whether ast is laid out like flat_ast_from_comp_unit lays it out, so
+// walking it can't go out of bounds or loop: every index and count in range,
+// every string terminated, and children before their parents. For trees
+// that came from somewhere else, like the cache
+bool flat_ast_check(const FlatAST *ast);
+
+static inline NodeKind flat_kind(const FlatAST *ast, FlatRef ref) {
+    return (NodeKind)ast->kinds[ref];
+}
+
+static inline FlatRef flat_rhs(FlatRef binary) { return binary - 1; }
+
+static inline const char *flat_str(const FlatAST *ast, FlatStr str) {
+    return ast->strings + str;
+}
+
+#endif
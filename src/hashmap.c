@@ -0,0 +1,127 @@
+#include "hashmap.h"
+#include "shared.h"
+#include <stdbool.h>
+
+// resized once it's 7/8 full, Robin Hood copes fine with that
+#define MAX_LOAD_NUM 7
+#define MAX_LOAD_DEN 8
+
+static void insert_slot(HashMap *map, HashMapSlot entry) {
+    size_t mask = map->cap - 1;
+    size_t i = entry.hash & mask;
+    entry.dist = 1;
+
+    while(true) {
+        HashMapSlot *slot = &map->slots[i];
+        if(slot->dist == 0) {
+            *slot = entry;
+            return;
+        }
+        // whoever is closer to home gives up their slot
+        if(slot->dist < entry.dist) {
+            HashMapSlot evicted = *slot;
+            *slot = entry;
+            entry = evicted;
+        }
+        i = (i + 1) & mask;
+        entry.dist++;
+    }
+}
+
+static void grow(HashMap *map) {
+    HashMapSlot *old = map->slots;
+    size_t old_cap = map->cap;
+
+    map->cap *= 2;
+    map->slots = stil_calloc(map->cap, sizeof(HashMapSlot));
+    for(size_t i = 0; i < old_cap; i++) {
+        if(old[i].dist != 0) {
+            insert_slot(map, old[i]);
+        }
+    }
+    stil_free(old);
+}
+
+static HashMapSlot *find_slot(const HashMap *map, uint64_t key,
+                              uint32_t hash) {
+    size_t mask = map->cap - 1;
+    size_t i = hash & mask;
+
+    // once we're further from home than the entry sitting here, the key
+    // would have taken this slot if it were in the map
+    for(uint32_t dist = 1;; dist++) {
+        HashMapSlot *slot = &map->slots[i];
+        if(slot->dist < dist) {
+            return NULL;
+        }
+        if(slot->hash == hash && slot->key == key) {
+            return slot;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+void hashmap_init(HashMap *map, size_t expected) {
+    size_t cap = 16;
+    while(cap * MAX_LOAD_NUM < expected * MAX_LOAD_DEN) {
+        cap *= 2;
+    }
+    map->slots = stil_calloc(cap, sizeof(HashMapSlot));
+    map->count = 0;
+    map->cap = cap;
+}
+
+void hashmap_deinit(HashMap *map) {
+    stil_free(map->slots);
+    map->slots = NULL;
+    map->count = map->cap = 0;
+}
+
+void *hashmap_get(const HashMap *map, uint64_t key, uint64_t hash) {
+    HashMapSlot *slot = find_slot(map, key, (uint32_t)hash);
+    return slot ? slot->value : NULL;
+}
+
+void *hashmap_put(HashMap *map, uint64_t key, uint64_t hash, void *value) {
+    HashMapSlot *slot = find_slot(map, key, (uint32_t)hash);
+    if(slot) {
+        void *old = slot->value;
+        slot->value = value;
+        return old;
+    }
+
+    if((map->count + 1) * MAX_LOAD_DEN > map->cap * MAX_LOAD_NUM) {
+        grow(map);
+    }
+    insert_slot(map, (HashMapSlot){
+                         .key = key,
+                         .value = value,
+                         .hash = (uint32_t)hash,
+                     });
+    map->count++;
+    return NULL;
+}
+
+void *hashmap_remove(HashMap *map, uint64_t key, uint64_t hash) {
+    HashMapSlot *slot = find_slot(map, key, (uint32_t)hash);
+    if(!slot) {
+        return NULL;
+    }
+    void *value = slot->value;
+
+    // Everything after it that isn't already home moves back a slot, so
+    // no tombstones are needed
+    size_t mask = map->cap - 1;
+    size_t i = slot - map->slots;
+    size_t next = (i + 1) & mask;
+    while(map->slots[next].dist > 1) {
+        map->slots[i] = map->slots[next];
+        map->slots[i].dist--;
+        i = next;
+        next = (next + 1) & mask;
+    }
+    map->slots[i] = (HashMapSlot){0};
+    map->count--;
+
+    return value;
+}
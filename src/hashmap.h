@@ -0,0 +1,52 @@
+#ifndef HASHMAP_H
+#define HASHMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Open addressing map from 64 bit keys to pointers, with Robin Hood probing.
+ * Keys are plain integers, anything bigger like a name gets interned first
+ * and keyed by its id. Callers hash the key themselves, hashmap_hash_u64
+ * does for keys that don't already come with one, so the hash of something
+ * looked up over and over only has to be worked out once.
+ *
+ * Entries never sit further than a few slots from where they hash to, since
+ * an entry that's far from home takes the slot of one that's closer to its
+ * own, which keeps lookups of missing keys short too. A NULL value reads the
+ * same as a missing key, so don't store those.
+ */
+
+typedef struct _HashMapSlot {
+    uint64_t key;
+    void *value;
+    uint32_t hash; // the low half of the key's hash
+    uint32_t dist; // 0 when empty, else 1 + how far it is from its home slot
+} HashMapSlot;
+
+typedef struct _HashMap {
+    HashMapSlot *slots;
+    size_t count;
+    size_t cap; // always a power of two
+} HashMap;
+
+static inline uint64_t hashmap_hash_u64(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccd;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53;
+    key ^= key >> 33;
+    return key;
+}
+
+// room for expected entries before the first resize
+void hashmap_init(HashMap *map, size_t expected);
+void hashmap_deinit(HashMap *map);
+// NULL if key isn't there
+void *hashmap_get(const HashMap *map, uint64_t key, uint64_t hash);
+// Returns the value key had before, if any
+void *hashmap_put(HashMap *map, uint64_t key, uint64_t hash, void *value);
+// Returns the value key had, if any
+void *hashmap_remove(HashMap *map, uint64_t key, uint64_t hash);
+
+#endif
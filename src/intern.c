@@ -0,0 +1,222 @@
+#include "intern.h"
+#include "arena.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Canonical strings are copied into an arena that is never reset, so the
+// pointers handed out by intern_str stay put however much the table grows
+#define INTERN_ARENA_SIZE ((size_t)1024 * 1024 * 1024)
+#define INTERN_INIT_SLOTS 1024
+// per thread, a power of two
+#define INTERN_CACHE_SLOTS 1024
+
+typedef struct _InternEntry {
+    const char *str;
+    uint32_t len;
+    uint32_t hash;
+} InternEntry;
+
+typedef struct _InternTable {
+    pthread_mutex_t lock;
+    bool ready;
+    Arena strings;
+
+    // indexed by id
+    InternEntry *entries;
+    size_t count, cap;
+
+    // open addressing over ids, 0 is an empty slot and anything else id + 1
+    uint32_t *slots;
+    size_t n_slots;
+} InternTable;
+
+static InternTable table = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+// The same few names come up over and over in a file, so each thread keeps
+// the ones it saw last and only takes the lock for the rest. An id and its
+// canonical string never change once handed out, so what's in here can't
+// go stale. Slots are picked by hash and just get overwritten
+typedef struct _InternCacheSlot {
+    const char *str; // NULL for an empty slot
+    uint32_t len;
+    uint32_t hash;
+    InternId id;
+} InternCacheSlot;
+
+static __thread InternCacheSlot cache[INTERN_CACHE_SLOTS];
+
+static inline char fold(char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// FNV-1a over the folded bytes
+static uint32_t hash_folded(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)fold(s[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// the canonical string, the same whichever spelling turns up first
+static const char *dup_upper(const char *s, size_t len) {
+    char *dup = arena_strndup(&table.strings, s, len);
+    for(size_t i = 0; i < len; i++) {
+        if(dup[i] >= 'a' && dup[i] <= 'z') {
+            dup[i] -= 'a' - 'A';
+        }
+    }
+    return dup;
+}
+
+static bool eq_folded(const char *a, const char *b, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+        if(fold(a[i]) != fold(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void ensure_ready() {
+    if(table.ready) {
+        return;
+    }
+    table.strings = arena_init(INTERN_ARENA_SIZE);
+    table.n_slots = INTERN_INIT_SLOTS;
+    table.slots = stil_calloc(table.n_slots, sizeof(uint32_t));
+    table.ready = true;
+}
+
+// slot holding s, or the empty slot it would go in
+static size_t find_slot(const char *s, size_t len, uint32_t hash) {
+    size_t mask = table.n_slots - 1;
+    size_t i = hash & mask;
+    while(table.slots[i] != 0) {
+        InternEntry *e = &table.entries[table.slots[i] - 1];
+        if(e->hash == hash && e->len == len && eq_folded(e->str, s, len)) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// kept at most half full so probe runs stay short
+static void grow_slots() {
+    size_t n_slots = table.n_slots * 2;
+    uint32_t *slots = stil_calloc(n_slots, sizeof(uint32_t));
+    for(size_t id = 0; id < table.count; id++) {
+        size_t i = table.entries[id].hash & (n_slots - 1);
+        while(slots[i] != 0) {
+            i = (i + 1) & (n_slots - 1);
+        }
+        slots[i] = id + 1;
+    }
+    stil_free(table.slots);
+    table.slots = slots;
+    table.n_slots = n_slots;
+}
+
+static inline InternCacheSlot *cache_slot(uint32_t hash) {
+    return &cache[hash & (INTERN_CACHE_SLOTS - 1)];
+}
+
+static inline bool cache_hit(const InternCacheSlot *cached, const char *s,
+                             size_t len, uint32_t hash) {
+    return cached->str && cached->hash == hash && cached->len == len &&
+           eq_folded(cached->str, s, len);
+}
+
+// table.lock has to be held
+static void cache_fill(InternCacheSlot *cached, InternId id) {
+    InternEntry *e = &table.entries[id];
+    *cached = (InternCacheSlot){
+        .str = e->str,
+        .len = e->len,
+        .hash = e->hash,
+        .id = id,
+    };
+}
+
+InternId intern(const char *s, size_t len) {
+    uint32_t hash = hash_folded(s, len);
+    InternCacheSlot *cached = cache_slot(hash);
+    if(cache_hit(cached, s, len, hash)) {
+        return cached->id;
+    }
+
+    pthread_mutex_lock(&table.lock);
+    ensure_ready();
+
+    size_t slot = find_slot(s, len, hash);
+    if(table.slots[slot] != 0) {
+        InternId id = table.slots[slot] - 1;
+        cache_fill(cached, id);
+        pthread_mutex_unlock(&table.lock);
+        return id;
+    }
+
+    if(table.count == table.cap) {
+        table.cap = table.cap ? table.cap * 2 : INTERN_INIT_SLOTS / 2;
+        table.entries =
+            stil_realloc(table.entries, table.cap * sizeof(InternEntry));
+    }
+    InternId id = table.count++;
+    table.entries[id] = (InternEntry){
+        .str = dup_upper(s, len),
+        .len = len,
+        .hash = hash,
+    };
+    table.slots[slot] = id + 1;
+    if(table.count * 2 > table.n_slots) {
+        grow_slots();
+    }
+    cache_fill(cached, id);
+
+    pthread_mutex_unlock(&table.lock);
+    return id;
+}
+
+InternId intern_find(const char *s, size_t len) {
+    uint32_t hash = hash_folded(s, len);
+    InternCacheSlot *cached = cache_slot(hash);
+    if(cache_hit(cached, s, len, hash)) {
+        return cached->id;
+    }
+
+    pthread_mutex_lock(&table.lock);
+    InternId id = INTERN_NONE;
+    if(table.ready) {
+        size_t slot = find_slot(s, len, hash);
+        if(table.slots[slot] != 0) {
+            id = table.slots[slot] - 1;
+        }
+    }
+    pthread_mutex_unlock(&table.lock);
+    return id;
+}
+
+// entries may move under a concurrent intern, the strings never do
+const char *intern_str(InternId id) {
+    pthread_mutex_lock(&table.lock);
+    const char *str = table.entries[id].str;
+    pthread_mutex_unlock(&table.lock);
+    return str;
+}
+
+size_t intern_len(InternId id) {
+    pthread_mutex_lock(&table.lock);
+    size_t len = table.entries[id].len;
+    pthread_mutex_unlock(&table.lock);
+    return len;
+}
+
+size_t intern_count() {
+    pthread_mutex_lock(&table.lock);
+    size_t count = table.count;
+    pthread_mutex_unlock(&table.lock);
+    return count;
+}
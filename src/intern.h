@@ -0,0 +1,31 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Process wide identifier table. ST names are case insensitive, so every
+ * spelling of a name maps to the same id and the same canonical string,
+ * the name in upper case. That doesn't depend on which spelling some other
+ * thread or file got to first, so it's safe to print. Ids are dense, start at 0
+ * and stay valid along with their strings until the process exits, so two
+ * names are the same name exactly when their ids are equal.
+ *
+ * Safe to call from several threads at once. Each thread remembers the names
+ * it looked up last, so most lookups don't touch the shared table's lock.
+ */
+
+typedef uint32_t InternId;
+
+#define INTERN_NONE UINT32_MAX
+
+InternId intern(const char *s, size_t len);
+// INTERN_NONE if no spelling of s has been interned yet
+InternId intern_find(const char *s, size_t len);
+const char *intern_str(InternId id);
+size_t intern_len(InternId id);
+// number of distinct names so far
+size_t intern_count();
+
+#endif
@@ -0,0 +1,433 @@
+#include "ir.h"
+#include "hashmap.h"
+#include "sema.h"
+
+// an expression along with whether its operands have been lowered already
+typedef struct _ExprFrame {
+    ASTNode *node;
+    bool operands_done;
+} ExprFrame;
+
+VEC_DEFINE(ExprFrameList, expr_frame_list, ExprFrame)
+VEC_DEFINE(VRegList, vreg_list, uint32_t)
+
+typedef struct _Lower {
+    IRModule *module;
+    CompilationUnit *comp_unit;
+    Arena *arena;
+    HashMap first_var; // VarDeclaration -> 1 + the var of its first label
+    IRFunction *func;  // the one being emitted into
+    ExprFrameList *pending;
+    VRegList *values; // of the operands lowered so far
+} Lower;
+
+static inline TypeDecl kind_of(Lower *l, TypeId id) {
+    return type_of(l->comp_unit, id)->kind;
+}
+
+static void begin_function(Lower *l, IRFunction *func) {
+    l->func = func;
+    func->insts = ir_inst_list_init(l->arena);
+    func->blocks = ir_block_list_init(l->arena);
+    func->n_vregs = 0;
+    ir_block_list_push(func->blocks, (IRBlock){0});
+}
+
+static void emit(Lower *l, IRInst inst) {
+    ir_inst_list_push(l->func->insts, inst);
+}
+
+static uint32_t emit_value(Lower *l, IRInst inst) {
+    inst.dst = l->func->n_vregs++;
+    emit(l, inst);
+    return inst.dst;
+}
+
+static void end_function(Lower *l) {
+    emit(l, (IRInst){.op = IR_RET});
+    IRBlockList *blocks = l->func->blocks;
+    ir_block_list_items(blocks)[blocks->count - 1].end =
+        l->func->insts->count;
+}
+
+static uint32_t var_of(Lower *l, Symbol *symbol) {
+    VarDeclaration *decl = symbol->decl;
+    uint64_t key = (uintptr_t)decl;
+    uint32_t var =
+        (uintptr_t)hashmap_get(&l->first_var, key, hashmap_hash_u64(key)) - 1;
+    // declarations hardly ever have more than a couple of names
+    for(size_t i = 0; i < decl->labels->count; i++) {
+        if(symbol_list_at(decl->labels, i)->id == symbol->id) {
+            return var + i;
+        }
+    }
+    return var;
+}
+
+static uint32_t convert(Lower *l, uint32_t vreg, TypeId from, TypeId to) {
+    if(from == to || kind_of(l, to) != TYPE_REAL) {
+        return vreg;
+    }
+    return emit_value(l, (IRInst){.op = IR_ITOF, .type = to, .a = vreg});
+}
+
+static uint32_t lower_binary(Lower *l, ASTNode *node) {
+    BinaryExpr *expr = &node->binary_expr;
+    uint32_t rhs = vreg_list_at(l->values, --l->values->count);
+    uint32_t lhs = vreg_list_at(l->values, --l->values->count);
+
+    // the operands only differ when one's an INT and the other a REAL
+    TypeId lhs_type = expr->lhs->type_id;
+    TypeId rhs_type = expr->rhs->type_id;
+    TypeId type = kind_of(l, lhs_type) == TYPE_REAL ? lhs_type : rhs_type;
+    return emit_value(l, (IRInst){
+                             .op = IR_ADD + (expr->op - OP_ADD),
+                             .type = type,
+                             .a = convert(l, lhs, lhs_type, type),
+                             .b = convert(l, rhs, rhs_type, type),
+                         });
+}
+
+static uint32_t lower_leaf(Lower *l, ASTNode *node) {
+    IRInst inst = {.op = IR_CONST, .type = node->type_id};
+    switch(node->kind) {
+        case ASTNODE_INT_LITERAL:
+            inst.int_val = node->int_literal.int_val;
+            break;
+        case ASTNODE_REAL_LITERAL:
+            inst.real_val = node->real_literal.real_val;
+            break;
+        case ASTNODE_STR_LITERAL:
+            inst.str_val = node->str_literal.str_val;
+            break;
+        case ASTNODE_BOOL_LITERAL:
+            inst.bool_val = node->bool_literal.bool_val;
+            break;
+        case ASTNODE_SYMBOL:
+            inst.op = IR_LOAD;
+            inst.a = var_of(l, &node->symbol);
+            break;
+        default:
+            stil_fatal("Can't lower node of kind %d", node->kind);
+    }
+    return emit_value(l, inst);
+}
+
+// operands come before what uses them, on an explicit stack since there's
+// no telling how deep an expression goes
+static uint32_t lower_expr(Lower *l, ASTNode *root) {
+    ExprFrameList *pending = l->pending;
+    pending->count = 0;
+    l->values->count = 0;
+    expr_frame_list_push(pending, (ExprFrame){root, false});
+
+    while(pending->count > 0) {
+        ExprFrame frame = expr_frame_list_at(pending, --pending->count);
+        ASTNode *node = frame.node;
+        uint32_t value;
+        switch(node->kind) {
+            case ASTNODE_BINARY_EXPR:
+                if(!frame.operands_done) {
+                    expr_frame_list_push(pending, (ExprFrame){node, true});
+                    expr_frame_list_push(
+                        pending, (ExprFrame){node->binary_expr.rhs, false});
+                    expr_frame_list_push(
+                        pending, (ExprFrame){node->binary_expr.lhs, false});
+                    continue;
+                }
+                value = lower_binary(l, node);
+                break;
+            case ASTNODE_UNARY_EXPR:
+                if(!frame.operands_done) {
+                    expr_frame_list_push(pending, (ExprFrame){node, true});
+                    expr_frame_list_push(
+                        pending, (ExprFrame){node->unary_expr.operand, false});
+                    continue;
+                }
+                value = emit_value(
+                    l, (IRInst){
+                           .op = node->unary_expr.op == OP_NEG ? IR_NEG
+                                                               : IR_NOT,
+                           .type = node->type_id,
+                           .a = vreg_list_at(l->values, --l->values->count),
+                       });
+                break;
+            default:
+                value = lower_leaf(l, node);
+                break;
+        }
+        vreg_list_push(l->values, value);
+    }
+    return vreg_list_at(l->values, 0);
+}
+
+static void store(Lower *l, uint32_t var, uint32_t value, TypeId from) {
+    TypeId type = ir_var_list_at(l->module->vars, var).type;
+    emit(l, (IRInst){
+                .op = IR_STORE,
+                .type = type,
+                .a = var,
+                .b = convert(l, value, from, type),
+            });
+}
+
+// temps without an initial value get one anyway, since they start over on
+// every call
+static uint32_t default_value(Lower *l, TypeId type) {
+    IRInst inst = {.op = IR_CONST, .type = type};
+    if(kind_of(l, type) == TYPE_STRING) {
+        inst.str_val = "";
+    }
+    return emit_value(l, inst);
+}
+
+// the initial values of a unit's declarations, either the temps or
+// everything else
+static void lower_declarations(Lower *l, STUnit *unit, bool temps) {
+    for(size_t i = 0; i < unit->variable_blocks->count; i++) {
+        VarBlock *block = &astnode_list_at(unit->variable_blocks, i)->var_block;
+        if((block->block_type == VARBLOCK_TEMP) != temps) {
+            continue;
+        }
+        for(size_t j = 0; j < block->var_decls->count; j++) {
+            VarDeclaration *decl =
+                &astnode_list_at(block->var_decls, j)->var_decl;
+            if(!decl->value && !temps) {
+                continue;
+            }
+            uint32_t value = decl->value ? lower_expr(l, decl->value)
+                                         : default_value(l, decl->type_id);
+            TypeId from = decl->value ? decl->value->type_id : decl->type_id;
+            for(size_t k = 0; k < decl->labels->count; k++) {
+                store(l, var_of(l, symbol_list_at(decl->labels, k)), value,
+                      from);
+            }
+        }
+    }
+}
+
+static void lower_unit(Lower *l, STUnit *unit) {
+    lower_declarations(l, unit, true);
+    for(size_t i = 0; i < unit->statements->count; i++) {
+        ASTNode *stmt = astnode_list_at(unit->statements, i);
+        switch(stmt->kind) {
+            case ASTNODE_ASSIGNMENT_STMT: {
+                ASTNode *value = stmt->asgmt.value;
+                store(l, var_of(l, stmt->asgmt.name), lower_expr(l, value),
+                      value->type_id);
+                break;
+            }
+            default:
+                stil_fatal("Can't lower statement of kind %d", stmt->kind);
+        }
+    }
+}
+
+static IRStorage storage_of(VarBlockType block_type) {
+    switch(block_type) {
+        case VARBLOCK_GLOBAL:
+            return IR_GLOBAL;
+        case VARBLOCK_TEMP:
+            return IR_TEMP;
+        default:
+            return IR_STATE;
+    }
+}
+
+static void add_vars(Lower *l, STUnit *unit, uint32_t func) {
+    IRFunction *owner = ir_function_list_items(l->module->funcs) + func;
+    for(size_t i = 0; i < unit->variable_blocks->count; i++) {
+        VarBlock *block = &astnode_list_at(unit->variable_blocks, i)->var_block;
+        IRStorage storage = storage_of(block->block_type);
+        for(size_t j = 0; j < block->var_decls->count; j++) {
+            VarDeclaration *decl =
+                &astnode_list_at(block->var_decls, j)->var_decl;
+            uint64_t key = (uintptr_t)decl;
+            hashmap_put(&l->first_var, key, hashmap_hash_u64(key),
+                        (void *)(uintptr_t)(l->module->vars->count + 1));
+            for(size_t k = 0; k < decl->labels->count; k++) {
+                ir_var_list_push(
+                    l->module->vars,
+                    (IRVar){
+                        .name = symbol_list_at(decl->labels, k)->id,
+                        .type = decl->type_id,
+                        .storage = storage,
+                        .owner = storage == IR_GLOBAL ? IR_NO_OWNER
+                                 : storage == IR_TEMP ? func
+                                                      : owner->state,
+                    });
+            }
+        }
+    }
+}
+
+IRModule *ir_lower(CompilationUnit *comp_unit, Arena *arena) {
+    IRModule *module = arena_alloc(arena, sizeof *module);
+    module->types = comp_unit->types;
+    module->vars = ir_var_list_init(arena);
+    module->funcs = ir_function_list_init(arena);
+
+    Lower l = {
+        .module = module,
+        .comp_unit = comp_unit,
+        .arena = arena,
+        .pending = expr_frame_list_init(NULL),
+        .values = vreg_list_init(NULL),
+    };
+    hashmap_init(&l.first_var, 64);
+
+    STUnitList *units = comp_unit->st_units;
+    uint32_t program = IR_NO_OWNER;
+    for(size_t i = 0; i < units->count; i++) {
+        STUnit *unit = st_unit_list_at(units, i);
+        if(unit->unit_type != STUNIT_ACTION) {
+            program = i;
+        }
+        ir_function_list_push(module->funcs,
+                              (IRFunction){
+                                  .name = unit->name->id,
+                                  .kind = unit->unit_type,
+                                  .state = program == IR_NO_OWNER ? i
+                                                                  : program,
+                              });
+    }
+    for(size_t i = 0; i < units->count; i++) {
+        add_vars(&l, st_unit_list_at(units, i), i);
+    }
+
+    module->init = (IRFunction){
+        .name = INTERN_NONE,
+        .kind = NO_STUNIT,
+        .state = IR_NO_OWNER,
+    };
+    begin_function(&l, &module->init);
+    for(size_t i = 0; i < units->count; i++) {
+        lower_declarations(&l, st_unit_list_at(units, i), false);
+    }
+    end_function(&l);
+
+    IRFunction *funcs = ir_function_list_items(module->funcs);
+    for(size_t i = 0; i < units->count; i++) {
+        begin_function(&l, &funcs[i]);
+        lower_unit(&l, st_unit_list_at(units, i));
+        end_function(&l);
+    }
+
+    hashmap_deinit(&l.first_var);
+    expr_frame_list_deinit(l.pending);
+    vreg_list_deinit(l.values);
+    return module;
+}
+
+const char *ir_op_name(IROp op) {
+    static const char *names[] = {
+        [IR_CONST] = "const", [IR_LOAD] = "load", [IR_STORE] = "store",
+        [IR_ITOF] = "itof",   [IR_NEG] = "neg",   [IR_NOT] = "not",
+        [IR_ADD] = "add",     [IR_SUB] = "sub",   [IR_MUL] = "mul",
+        [IR_DIV] = "div",     [IR_MOD] = "mod",   [IR_POW] = "pow",
+        [IR_LT] = "lt",       [IR_LTE] = "lte",   [IR_GT] = "gt",
+        [IR_GTE] = "gte",     [IR_EQ] = "eq",     [IR_NE] = "ne",
+        [IR_AND] = "and",     [IR_OR] = "or",     [IR_XOR] = "xor",
+        [IR_RET] = "ret",
+    };
+    return names[op];
+}
+
+static const char *type_name(IRModule *module, TypeId id) {
+    return intern_str(type_list_at(module->types, id).name);
+}
+
+static void dump_const(IRModule *module, const IRInst *inst) {
+    switch(type_list_at(module->types, inst->type).kind) {
+        case TYPE_INT:
+            printf("%d", inst->int_val);
+            break;
+        case TYPE_REAL:
+            printf("%g", inst->real_val);
+            break;
+        case TYPE_STRING:
+            printf("'%s'", inst->str_val);
+            break;
+        case TYPE_BOOL:
+            printf("%s", inst->bool_val ? "TRUE" : "FALSE");
+            break;
+        default:
+            printf("?");
+            break;
+    }
+}
+
+static void dump_inst(IRModule *module, const IRInst *inst) {
+    IRVar var;
+    printf("    ");
+    switch(inst->op) {
+        case IR_CONST:
+            printf("%%%u = const %s ", inst->dst,
+                   type_name(module, inst->type));
+            dump_const(module, inst);
+            break;
+        case IR_LOAD:
+            var = ir_var_list_at(module->vars, inst->a);
+            printf("%%%u = load %s @%u:%s", inst->dst,
+                   type_name(module, inst->type), inst->a,
+                   intern_str(var.name));
+            break;
+        case IR_STORE:
+            var = ir_var_list_at(module->vars, inst->a);
+            printf("store %s @%u:%s, %%%u", type_name(module, inst->type),
+                   inst->a, intern_str(var.name), inst->b);
+            break;
+        case IR_ITOF:
+        case IR_NEG:
+        case IR_NOT:
+            printf("%%%u = %s %s %%%u", inst->dst, ir_op_name(inst->op),
+                   type_name(module, inst->type), inst->a);
+            break;
+        case IR_RET:
+            printf("ret");
+            break;
+        default:
+            printf("%%%u = %s %s %%%u, %%%u", inst->dst, ir_op_name(inst->op),
+                   type_name(module, inst->type), inst->a, inst->b);
+            break;
+    }
+    printf("\n");
+}
+
+static void dump_function(IRModule *module, IRFunction *func) {
+    IRInst *insts = ir_inst_list_items(func->insts);
+    for(size_t i = 0; i < func->blocks->count; i++) {
+        IRBlock block = ir_block_list_at(func->blocks, i);
+        INDENTED(1, "bb%zu:", i);
+        for(uint32_t j = block.start; j < block.end; j++) {
+            dump_inst(module, &insts[j]);
+        }
+    }
+}
+
+void ir_dump(IRModule *module) {
+    IRFunction *funcs = ir_function_list_items(module->funcs);
+    for(size_t i = 0; i < module->vars->count; i++) {
+        IRVar var = ir_var_list_at(module->vars, i);
+        printf("@%zu:%s %s", i, intern_str(var.name),
+               type_name(module, var.type));
+        if(var.storage == IR_GLOBAL) {
+            printf(" global\n");
+        } else {
+            printf(" %s of %s\n", var.storage == IR_TEMP ? "temp" : "state",
+                   intern_str(funcs[var.owner].name));
+        }
+    }
+
+    printf("init:\n");
+    dump_function(module, &module->init);
+    for(size_t i = 0; i < module->funcs->count; i++) {
+        IRFunction *func = &funcs[i];
+        printf("%s %s", st_unit_type_dbg(func->kind), intern_str(func->name));
+        if(func->state != i) {
+            printf(" on %s", intern_str(funcs[func->state].name));
+        }
+        printf(":\n");
+        dump_function(module, func);
+    }
+}
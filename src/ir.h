@@ -0,0 +1,132 @@
+#ifndef IR_H
+#define IR_H
+
+#include "arena.h"
+#include "ast.h"
+#include "vec.h"
+
+/*
+ * Three address code for everything after the tree. Each unit becomes an
+ * IRFunction whose instructions sit one after the other in a single array,
+ * split into basic blocks that are ranges of it, so going over a function
+ * never has to chase a pointer. Values are virtual registers, numbered from
+ * 0 in each function and written exactly once. Variables aren't registers,
+ * they're slots in the module's storage that get loaded and stored, which
+ * keeps them where the program expects them between cycles.
+ *
+ * All the operands of an instruction already have its type. Wherever an
+ * INT is used as a REAL there's an explicit ITOF, so nothing after this has
+ * to think about conversions. A register that was LOADed is never read
+ * after a STORE that changes the same variable, so the variable can stand
+ * in for it.
+ *
+ *   op         does                          type is that of
+ *   CONST      dst = the literal             the literal
+ *   LOAD       dst = var a                   var a
+ *   STORE      var a = b                     var a
+ *   ITOF       dst = (REAL)a                 dst
+ *   NEG, NOT   dst = op a                    a and dst
+ *   ADD..XOR   dst = a op b                  a and b, dst is BOOL for LT..NE
+ *   RET        back to the caller
+ *
+ * Everything hangs off the arena handed to ir_lower.
+ */
+
+typedef enum _IROp {
+    IR_CONST,
+    IR_LOAD,
+    IR_STORE,
+    IR_ITOF,
+
+    IR_NEG,
+    IR_NOT,
+
+    // in the same order as InfixOperator
+    IR_ADD,
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_MOD,
+    IR_POW,
+    IR_LT,
+    IR_LTE,
+    IR_GT,
+    IR_GTE,
+    IR_EQ,
+    IR_NE,
+    IR_AND,
+    IR_OR,
+    IR_XOR,
+
+    IR_RET,
+} IROp;
+
+typedef struct _IRInst {
+    IROp op;
+    TypeId type;
+    uint32_t dst;
+    union {
+        struct {
+            uint32_t a, b;
+        };
+        int int_val;
+        double real_val;
+        bool bool_val;
+        const char *str_val;
+    };
+} IRInst;
+
+// instructions [start, end) of the function
+typedef struct _IRBlock {
+    uint32_t start, end;
+} IRBlock;
+
+typedef enum _IRStorage {
+    IR_GLOBAL, // one for the whole module
+    IR_STATE,  // belongs to a program and keeps its value between cycles
+    IR_TEMP,   // starts over each time its function is called
+} IRStorage;
+
+#define IR_NO_OWNER UINT32_MAX
+
+typedef struct _IRVar {
+    InternId name;
+    TypeId type;
+    IRStorage storage;
+    uint32_t owner; // index of the function it belongs to, IR_NO_OWNER for
+                    // globals
+} IRVar;
+
+VEC_DEFINE(IRInstList, ir_inst_list, IRInst)
+VEC_DEFINE(IRBlockList, ir_block_list, IRBlock)
+VEC_DEFINE(IRVarList, ir_var_list, IRVar)
+
+typedef struct _IRFunction {
+    InternId name;
+    StUnitType kind;
+    // The function whose IR_STATE variables this one works on. A PROGRAM's
+    // own, an ACTION's is the PROGRAM before it, or itself if there's none
+    uint32_t state;
+    IRInstList *insts;
+    IRBlockList *blocks;
+    uint32_t n_vregs;
+} IRFunction;
+
+VEC_DEFINE(IRFunctionList, ir_function_list, IRFunction)
+
+typedef struct _IRModule {
+    TypeList *types;
+    IRVarList *vars; // storage starts out zeroed
+    // one per STUnit, in the same order
+    IRFunctionList *funcs;
+    // runs once before anything else to give globals and state variables
+    // their initial values
+    IRFunction init;
+} IRModule;
+
+// comp_unit has to have gone through sema_comp_unit without errors
+IRModule *ir_lower(CompilationUnit *comp_unit, Arena *arena);
+void ir_dump(IRModule *module);
+const char *ir_op_name(IROp op);
+
+#endif
@@ -0,0 +1,155 @@
+// Generated by scripts/kwgen.py, do not edit by hand
+#include "keywords.h"
+#include <stdint.h>
+
+#define KW_MIN_LEN 2
+#define KW_MAX_LEN 18
+
+typedef struct _KwSlot {
+    const char *spelling;
+    uint8_t len;
+    int kind;
+} KwSlot;
+
+static const uint16_t kw_displacements[64] = {
+    1, 1, 0, 0, 0, 1, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 2, 0, 0, 0, 0, 0, 0,
+    0, 0, 1, 0, 0, 2, 0, 0,
+    0, 1, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    1, 1, 0, 0, 1, 0, 0, 0,
+    2, 0, 0, 1, 0, 2, 0, 0,
+};
+
+static const KwSlot kw_slots[256] = {
+    [0] = {"WHILE", 5, TOKEN_KEYWORD_WHILE},
+    [8] = {"PROPERTY", 8, TOKEN_KEYWORD_PROPERTY},
+    [12] = {"TYPE", 4, TOKEN_KEYWORD_TYPE},
+    [13] = {"PROTECTED", 9, TOKEN_KEYWORD_ACCESS_PROTECTED},
+    [14] = {"END_TYPE", 8, TOKEN_KEYWORD_END_TYPE},
+    [18] = {"ABSTRACT", 8, TOKEN_KEYWORD_ABSTRACT},
+    [22] = {"ENDIF", 5, TOKEN_KEYWORD_END_IF},
+    [23] = {"VAR_TEMP", 8, TOKEN_KEYWORD_VAR_TEMP},
+    [24] = {"VAR_GLOBAL", 10, TOKEN_KEYWORD_VAR_GLOBAL},
+    [25] = {"VARINPUT", 8, TOKEN_KEYWORD_VAR_INPUT},
+    [27] = {"REFTO", 5, TOKEN_KEYWORD_REFERENCE_TO},
+    [28] = {"VAR_OUTPUT", 10, TOKEN_KEYWORD_VAR_OUTPUT},
+    [29] = {"INTERNAL", 8, TOKEN_KEYWORD_ACCESS_INTERNAL},
+    [33] = {"END_VAR", 7, TOKEN_KEYWORD_END_VAR},
+    [34] = {"CLASS", 5, TOKEN_KEYWORD_CLASS},
+    [36] = {"POINTER", 7, TOKEN_KEYWORD_POINTER},
+    [37] = {"EXIT", 4, TOKEN_KEYWORD_EXIT},
+    [42] = {"BOOL", 4, TOKEN_KEYWORD_BOOL},
+    [43] = {"END_FUNCTION_BLOCK", 18, TOKEN_KEYWORD_END_FUNCTION_BLOCK},
+    [44] = {"ELSIF", 5, TOKEN_KEYWORD_ELSE_IF},
+    [47] = {"RETURN", 6, TOKEN_KEYWORD_RETURN},
+    [48] = {"END_PROPERTY", 12, TOKEN_KEYWORD_END_PROPERTY},
+    [51] = {"ENDVAR", 6, TOKEN_KEYWORD_END_VAR},
+    [54] = {"ENDMETHOD", 9, TOKEN_KEYWORD_END_METHOD},
+    [55] = {"PROGRAM", 7, TOKEN_KEYWORD_PROGRAM},
+    [56] = {"END_FUNCTION", 12, TOKEN_KEYWORD_END_FUNCTION},
+    [58] = {"PRIVATE", 7, TOKEN_KEYWORD_ACCESS_PRIVATE},
+    [59] = {"AND", 3, TOKEN_OPERATOR_AND},
+    [61] = {"ENDREPEAT", 9, TOKEN_KEYWORD_END_REPEAT},
+    [62] = {"FUNCTIONBLOCK", 13, TOKEN_KEYWORD_FUNCTION_BLOCK},
+    [64] = {"STRUCT", 6, TOKEN_KEYWORD_STRUCT},
+    [67] = {"END_REPEAT", 10, TOKEN_KEYWORD_END_REPEAT},
+    [69] = {"VAR", 3, TOKEN_KEYWORD_VAR},
+    [70] = {"ENDPROGRAM", 10, TOKEN_KEYWORD_END_PROGRAM},
+    [72] = {"CASE", 4, TOKEN_KEYWORD_CASE},
+    [74] = {"BY", 2, TOKEN_KEYWORD_BY},
+    [76] = {"END_STRUCT", 10, TOKEN_KEYWORD_END_STRUCT},
+    [77] = {"IMPLEMENTS", 10, TOKEN_KEYWORD_IMPLEMENTS},
+    [79] = {"METHOD", 6, TOKEN_KEYWORD_METHOD},
+    [80] = {"END_ACTIONS", 11, TOKEN_KEYWORD_END_ACTIONS},
+    [81] = {"FUNCTION", 8, TOKEN_KEYWORD_FUNCTION},
+    [83] = {"END_METHOD", 10, TOKEN_KEYWORD_END_METHOD},
+    [84] = {"ARRAY", 5, TOKEN_KEYWORD_ARRAY},
+    [85] = {"ENDINTERFACE", 12, TOKEN_KEYWORD_END_INTERFACE},
+    [88] = {"NONRETAIN", 9, TOKEN_KEYWORD_NON_RETAIN},
+    [94] = {"STRING", 6, TOKEN_KEYWORD_STRING},
+    [95] = {"REPEAT", 6, TOKEN_KEYWORD_REPEAT},
+    [96] = {"DO", 2, TOKEN_KEYWORD_DO},
+    [97] = {"VAR_IN_OUT", 10, TOKEN_KEYWORD_VAR_IN_OUT},
+    [103] = {"REAL", 4, TOKEN_KEYWORD_REAL},
+    [108] = {"ENDFUNCTION", 11, TOKEN_KEYWORD_END_FUNCTION},
+    [110] = {"TRUE", 4, TOKEN_LITERAL_TRUE},
+    [112] = {"EXTENDS", 7, TOKEN_KEYWORD_EXTENDS},
+    [119] = {"ENDSTRUCT", 9, TOKEN_KEYWORD_END_STRUCT},
+    [124] = {"ACTIONS", 7, TOKEN_KEYWORD_ACTIONS},
+    [125] = {"REF_TO", 6, TOKEN_KEYWORD_REFERENCE_TO},
+    [129] = {"FOR", 3, TOKEN_KEYWORD_FOR},
+    [130] = {"MOD", 3, TOKEN_OPERATOR_MODULO},
+    [131] = {"VARINOUT", 8, TOKEN_KEYWORD_VAR_IN_OUT},
+    [136] = {"IF", 2, TOKEN_KEYWORD_IF},
+    [143] = {"ENDACTION", 9, TOKEN_KEYWORD_END_ACTION},
+    [147] = {"END_INTERFACE", 13, TOKEN_KEYWORD_END_INTERFACE},
+    [148] = {"END_CASE", 8, TOKEN_KEYWORD_END_CASE},
+    [149] = {"END_ACTION", 10, TOKEN_KEYWORD_END_ACTION},
+    [158] = {"INT", 3, TOKEN_KEYWORD_INT},
+    [159] = {"VAR_CONFIG", 10, TOKEN_KEYWORD_VAR_CONFIG},
+    [161] = {"ENDACTIONS", 10, TOKEN_KEYWORD_END_ACTIONS},
+    [162] = {"NON_RETAIN", 10, TOKEN_KEYWORD_NON_RETAIN},
+    [165] = {"OF", 2, TOKEN_KEYWORD_OF},
+    [170] = {"ENDFUNCTIONBLOCK", 16, TOKEN_KEYWORD_END_FUNCTION_BLOCK},
+    [172] = {"XOR", 3, TOKEN_OPERATOR_XOR},
+    [173] = {"INTERFACE", 9, TOKEN_KEYWORD_INTERFACE},
+    [174] = {"CONTINUE", 8, TOKEN_KEYWORD_CONTINUE},
+    [177] = {"RETAIN", 6, TOKEN_KEYWORD_RETAIN},
+    [178] = {"ENDPROPERTY", 11, TOKEN_KEYWORD_END_PROPERTY},
+    [182] = {"FINAL", 5, TOKEN_KEYWORD_FINAL},
+    [184] = {"END_WHILE", 9, TOKEN_KEYWORD_END_WHILE},
+    [185] = {"ENDTYPE", 7, TOKEN_KEYWORD_END_TYPE},
+    [186] = {"ENDCLASS", 8, TOKEN_KEYWORD_END_CLASS},
+    [198] = {"ACTION", 6, TOKEN_KEYWORD_ACTION},
+    [199] = {"OR", 2, TOKEN_OPERATOR_OR},
+    [201] = {"AT", 2, TOKEN_KEYWORD_AT},
+    [202] = {"WSTRING", 7, TOKEN_KEYWORD_WIDE_STRING},
+    [204] = {"THEN", 4, TOKEN_KEYWORD_THEN},
+    [205] = {"END_CLASS", 9, TOKEN_KEYWORD_END_CLASS},
+    [206] = {"VAR_INPUT", 9, TOKEN_KEYWORD_VAR_INPUT},
+    [211] = {"VAR_EXTERNAL", 12, TOKEN_KEYWORD_VAR_EXTERNAL},
+    [214] = {"ENDWHILE", 8, TOKEN_KEYWORD_END_WHILE},
+    [217] = {"END_FOR", 7, TOKEN_KEYWORD_END_FOR},
+    [218] = {"ENDCASE", 7, TOKEN_KEYWORD_END_CASE},
+    [219] = {"PUBLIC", 6, TOKEN_KEYWORD_ACCESS_PUBLIC},
+    [226] = {"CONSTANT", 8, TOKEN_KEYWORD_CONSTANT},
+    [227] = {"FALSE", 5, TOKEN_LITERAL_FALSE},
+    [232] = {"ELSE", 4, TOKEN_KEYWORD_ELSE},
+    [233] = {"VARGLOBAL", 9, TOKEN_KEYWORD_VAR_GLOBAL},
+    [234] = {"VAROUTPUT", 9, TOKEN_KEYWORD_VAR_OUTPUT},
+    [235] = {"FUNCTION_BLOCK", 14, TOKEN_KEYWORD_FUNCTION_BLOCK},
+    [240] = {"END_PROGRAM", 11, TOKEN_KEYWORD_END_PROGRAM},
+    [241] = {"ENDFOR", 6, TOKEN_KEYWORD_END_FOR},
+    [245] = {"VARTEMP", 7, TOKEN_KEYWORD_VAR_TEMP},
+    [248] = {"TO", 2, TOKEN_KEYWORD_TO},
+    [249] = {"END_IF", 6, TOKEN_KEYWORD_END_IF},
+    [250] = {"OVERRIDE", 8, TOKEN_KEYWORD_OVERRIDE},
+    [252] = {"NOT", 3, TOKEN_OPERATOR_NOT},
+    [255] = {"UNTIL", 5, TOKEN_KEYWORD_UNTIL},
+};
+
+int kw_lookup(const char *lexeme, size_t len) {
+    if(len < KW_MIN_LEN || len > KW_MAX_LEN) {
+        return -1;
+    }
+
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)(lexeme[i] & 0xDF)) * 16777619u;
+    }
+
+    uint32_t disp = kw_displacements[h % 64];
+    uint32_t slot = ((h ^ (disp * 0x9E3779B1u)) * 0x85EBCA6Bu) >> 24;
+    const KwSlot *kw = &kw_slots[slot];
+    if(kw->len != len) {
+        return -1;
+    }
+    for(size_t i = 0; i < len; i++) {
+        if((lexeme[i] & 0xDF) != kw->spelling[i]) {
+            return -1;
+        }
+    }
+    return kw->kind;
+}
@@ -0,0 +1,12 @@
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+
+#include "lexer.h"
+
+// Case insensitive keyword lookup straight on the source bytes.
+// Returns the keyword's TokenKind or -1 if the lexeme is a plain ident.
+// The tables behind it are static and read-only so every lexer on every
+// thread shares them. See scripts/kwgen.py for how they are built.
+int kw_lookup(const char *lexeme, size_t len);
+
+#endif
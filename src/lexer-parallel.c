@@ -0,0 +1,149 @@
+#define _GNU_SOURCE
+#include "lexer.h"
+#include <pthread.h>
+#include <string.h>
+
+// below this it isn't worth waking up another thread
+#define PARALLEL_LEX_MIN_CHUNK (1024 * 1024)
+
+typedef struct _LexJob {
+    const Lexer *lexer;
+    size_t start, end;
+    TokenBuffer *toks;
+    bool hit_eof;
+} LexJob;
+
+/*
+ * Finds up to n_chunks - 1 offsets where the source can be cut without
+ * changing how it lexes. A cut goes right after a newline that isn't inside
+ * a '...' string or a (* *) comment, since those are the only tokens that
+ * can run across lines. Only quotes and (* need looking at outside of them,
+ * and every other byte is skipped over. This has to agree with lex_token on
+ * where strings and comments start and end.
+ */
+static size_t find_split_points(const Lexer *lexer, size_t n_chunks,
+                                size_t *splits) {
+    const char *start = lexer->whole;
+    const char *end = start + lexer->source_len;
+    const char *p = start;
+    size_t n_splits = 0;
+    size_t target = lexer->source_len / n_chunks;
+
+    while(p < end && n_splits < n_chunks - 1) {
+        switch(*p) {
+            case '\'':
+                {
+                    const char *close = memchr(p + 1, '\'', end - p - 1);
+                    // unclosed strings get skipped over by the lexer
+                    p = close ? close + 1 : p + 1;
+                    continue;
+                }
+            case '(':
+                if(p + 1 < end && p[1] == '*') {
+                    const char *close = memmem(p + 2, end - p - 2, "*)", 2);
+                    if(!close) {
+                        // unclosed comment swallows the rest of the file
+                        return n_splits;
+                    }
+                    p = close + 2;
+                    continue;
+                }
+                break;
+            case '\n':
+                if((size_t)(p - start) >= target) {
+                    splits[n_splits++] = p - start + 1;
+                    target = lexer->source_len / n_chunks * (n_splits + 1);
+                }
+                break;
+        }
+        p++;
+    }
+
+    return n_splits;
+}
+
+static void *lex_job_run(void *arg) {
+    LexJob *job = arg;
+    // chunks come out a bit under the one token per 6 bytes of a whole file
+    job->toks = token_buffer_init((job->end - job->start) / 6 + 16);
+    job->hit_eof =
+        lexer_tokenize_span(job->lexer, job->start, job->end, job->toks);
+    return NULL;
+}
+
+TokenBuffer *lexer_tokenize_parallel(Lexer *lexer, int n_threads) {
+    size_t n_chunks = n_threads > 0 ? (size_t)n_threads : 1;
+    if(lexer->source_len / PARALLEL_LEX_MIN_CHUNK < n_chunks) {
+        n_chunks = lexer->source_len / PARALLEL_LEX_MIN_CHUNK;
+    }
+    if(n_chunks <= 1) {
+        return lexer_tokenize_all(lexer);
+    }
+    lexer_check_tokenizable(lexer);
+
+    // on the heap, -j can be as big as anyone likes
+    size_t *splits = stil_malloc(n_chunks * sizeof *splits);
+    size_t n_splits = find_split_points(lexer, n_chunks, splits);
+    size_t n_jobs = n_splits + 1;
+
+    LexJob *jobs = stil_malloc(n_jobs * sizeof *jobs);
+    pthread_t *threads = stil_malloc(n_jobs * sizeof *threads);
+    for(size_t i = 0; i < n_jobs; i++) {
+        jobs[i] = (LexJob){
+            .lexer = lexer,
+            .start = i == 0 ? 0 : splits[i - 1],
+            .end = i == n_splits ? lexer->source_len : splits[i],
+        };
+    }
+
+    // the calling thread takes the first chunk itself
+    for(size_t i = 1; i < n_jobs; i++) {
+        if(pthread_create(&threads[i], NULL, lex_job_run, &jobs[i]) != 0) {
+            stil_fatal("Couldn't spawn lexer thread");
+        }
+    }
+    lex_job_run(&jobs[0]);
+    for(size_t i = 1; i < n_jobs; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    stil_free(splits);
+    stil_free(threads);
+
+    // a NUL byte ends the stream early so later chunks get dropped,
+    // exactly like the serial lexer never getting to them
+    size_t n_used = n_jobs;
+    size_t total = 1;
+    for(size_t i = 0; i < n_jobs; i++) {
+        total += jobs[i].toks->count;
+        if(jobs[i].hit_eof) {
+            n_used = i + 1;
+            break;
+        }
+    }
+
+    TokenBuffer *toks = token_buffer_init(total);
+    for(size_t i = 0; i < n_used; i++) {
+        TokenBuffer *part = jobs[i].toks;
+        memcpy(toks->kinds + toks->count, part->kinds,
+               part->count * sizeof(TokenKind));
+        memcpy(toks->offsets + toks->count, part->offsets,
+               part->count * sizeof(uint32_t));
+        memcpy(toks->lens + toks->count, part->lens,
+               part->count * sizeof(uint32_t));
+        toks->count += part->count;
+    }
+    for(size_t i = 0; i < n_jobs; i++) {
+        token_buffer_deinit(jobs[i].toks);
+    }
+
+    if(!jobs[n_used - 1].hit_eof) {
+        token_buffer_push(toks, (Token){.kind = TOKEN_EOF,
+                                        .offset = lexer->source_len,
+                                        .len = 0});
+    }
+    stil_free(jobs);
+    lexer->pos = lexer->source_len;
+    lexer->rest = lexer->whole + lexer->source_len;
+
+    return toks;
+}
@@ -1,85 +1,248 @@
 #include "lexer.h"
+#include "keywords.h"
+#include "scan.h"
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-static void fillup_keywords(kw_ht *table);
 static inline void advance(Lexer *l);
-static inline bool is_st_ident_ch(char c);
-static inline char *str_to_upper(char *s);
+static inline void advance_n(Lexer *l, size_t n);
+static inline const char *source_end(Lexer *l);
+static inline bool can_refill(Lexer *l);
+static void stream_refill(Lexer *lexer);
+
+// For anything that can't be mapped, i.e. pipes and other special files
+static char *read_whole_fd(int fd, const char *filepath, size_t *len) {
+    size_t cap = 64 * 1024;
+    size_t used = 0;
+    char *buffer = stil_malloc(cap);
+
+    while(true) {
+        if(used == cap) {
+            cap *= 2;
+            buffer = stil_realloc(buffer, cap);
+        }
+        ssize_t n = read(fd, buffer + used, cap - used);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            stil_fatal("Couldn't read from file %s: %s", filepath,
+                       strerror(errno));
+        }
+        if(n == 0) {
+            break;
+        }
+        used += n;
+    }
+
+    *len = used;
+    return buffer;
+}
+
+static size_t count_newlines(const char *s, size_t len) {
+    size_t n = 0;
+    const char *end = s + len;
+    while((s = memchr(s, '\n', end - s))) {
+        n++;
+        s++;
+    }
+    return n;
+}
+
+// one entry per line, so the first line starting at 0 and then one
+// right after every newline, even a trailing one
+static void build_line_index(Lexer *lexer) {
+    const char *start = lexer->whole;
+    const char *end = start + lexer->source_len;
+
+    lexer->n_lines = count_newlines(start, lexer->source_len) + 1;
+    lexer->line_starts = stil_malloc(lexer->n_lines * sizeof(size_t));
+    lexer->line_starts[0] = 0;
+
+    size_t i = 1;
+    for(const char *p = start; (p = memchr(p, '\n', end - p)); p++) {
+        lexer->line_starts[i++] = p - start + 1;
+    }
+}
+
+static void drop_line_index(Lexer *lexer) {
+    stil_free(lexer->line_starts);
+    lexer->line_starts = NULL;
+    lexer->n_lines = 0;
+}
+
+// index of the line holding off, which is relative to whole
+static size_t line_index_of(Lexer *lexer, size_t off) {
+    if(!lexer->line_starts) {
+        build_line_index(lexer);
+    }
+
+    // last line that starts at or before off
+    size_t lo = 0, hi = lexer->n_lines;
+    while(hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(lexer->line_starts[mid] <= off) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// where line idx ends, not counting its newline
+static size_t line_end_of(Lexer *lexer, size_t idx) {
+    return idx + 1 < lexer->n_lines ? lexer->line_starts[idx + 1] - 1
+                                    : lexer->source_len;
+}
 
-/* Lexer *lexer_init(const char *filepath, Arena *arena) { */
-Lexer *lexer_init(const char *filepath) {
-    /* Lexer *lexer = arena_alloc(arena, sizeof *lexer); */
-    Lexer *lexer = stil_malloc(sizeof *lexer);
+void lexer_index_lines(Lexer *lexer) {
+    if(!lexer->line_starts) {
+        build_line_index(lexer);
+    }
+}
+
+size_t lexer_line_col(Lexer *lexer, size_t offset, size_t *column) {
+    size_t off = offset - lexer->base;
+    size_t idx = line_index_of(lexer, off);
+    if(column) {
+        *column = off - lexer->line_starts[idx];
+    }
+    return 1 + lexer->base_line + idx;
+}
 
-    FILE *fd = fopen(filepath, "r");
-    if(!fd) {
+Lexer *lexer_init(const char *filepath, Arena *arena) {
+    Lexer *lexer = arena_alloc(arena, sizeof *lexer);
+
+    // stdin can't be mapped, it gets read in full like any other pipe
+    bool from_stdin = strcmp(filepath, "-") == 0;
+    int fd = from_stdin ? STDIN_FILENO : open(filepath, O_RDONLY);
+    if(fd < 0) {
         stil_fatal("Couldn't open file %s", filepath);
     }
 
-    fseek(fd, 0, SEEK_END);
-    size_t len = ftell(fd);
-    fseek(fd, 0, SEEK_SET);
-    /* char *buffer = arena_alloc(arena, len + 1); */
-    char *buffer = stil_malloc(len + 1);
-    size_t bytes_read = fread(buffer, sizeof buffer[0], len, fd);
-    if(bytes_read != len) {
-        stil_fatal("Couldn't read from file %s", filepath);
+    struct stat st;
+    if(fstat(fd, &st) < 0) {
+        stil_fatal("Couldn't stat file %s: %s", filepath, strerror(errno));
+    }
+
+    // Regular files are scanned straight out of the page cache. Nothing in
+    // the lexer relies on a NUL terminator so the mapping is used as is.
+    // mmap refuses empty files, which is fine since they have nothing to map
+    if(S_ISREG(st.st_mode) && st.st_size > 0) {
+        size_t len = (size_t)st.st_size;
+        void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map == MAP_FAILED) {
+            stil_fatal("Couldn't mmap file %s: %s", filepath, strerror(errno));
+        }
+        madvise(map, len, MADV_SEQUENTIAL);
+
+        lexer->whole = map;
+        lexer->source_len = len;
+        lexer->backing = SOURCE_MAPPED;
+    } else if(S_ISREG(st.st_mode)) {
+        lexer->whole = "";
+        lexer->source_len = 0;
+        lexer->backing = SOURCE_STATIC;
+    } else {
+        lexer->whole = read_whole_fd(fd, filepath, &lexer->source_len);
+        lexer->backing = SOURCE_HEAP;
+    }
+    if(!from_stdin) {
+        close(fd);
     }
-    buffer[bytes_read] = '\0';
 
-    lexer->whole = strdup(buffer);
     lexer->rest = lexer->whole;
-    lexer->source = strdup(filepath);
-    lexer->kw_lookup = ht_init();
-    fillup_keywords(lexer->kw_lookup);
+    lexer->source = arena_strndup(arena, filepath, strlen(filepath));
 
     lexer->pos = 0;
-    lexer->source_len = bytes_read;
     lexer->n_errors = 0;
-    fclose(fd);
+    lexer->diag = stdout;
 
     return lexer;
 }
 
-/* static Token *make_sym_token(TokenKind kind, size_t offset, Arena *arena) {
- */
-static Token *make_sym_token(TokenKind kind, size_t offset) {
-    /* Token *tok = (Token *)arena_alloc(arena, sizeof *tok); */
-    Token *tok = stil_malloc(sizeof *tok);
-    tok->kind = kind;
-    tok->offset = offset;
-    tok->string_val = NULL;
+Lexer *lexer_init_stream(const char *filepath, Arena *arena) {
+    Lexer *lexer = arena_alloc(arena, sizeof *lexer);
 
-    return tok;
+    bool from_stdin = strcmp(filepath, "-") == 0;
+    lexer->stream_fd = from_stdin ? STDIN_FILENO : open(filepath, O_RDONLY);
+    if(lexer->stream_fd < 0) {
+        stil_fatal("Couldn't open file %s", filepath);
+    }
+
+    lexer->window_cap = LEX_STREAM_WINDOW;
+    lexer->whole = stil_malloc(lexer->window_cap);
+    lexer->rest = lexer->whole;
+    lexer->source = arena_strndup(arena, filepath, strlen(filepath));
+    lexer->backing = SOURCE_STREAM;
+    lexer->source_len = 0;
+    lexer->pos = 0;
+    lexer->n_errors = 0;
+    lexer->diag = stdout;
+    stream_refill(lexer);
+
+    return lexer;
+}
+
+void lexer_deinit(Lexer *lexer) {
+    switch(lexer->backing) {
+        case SOURCE_MAPPED:
+            munmap((void *)lexer->whole, lexer->source_len);
+            break;
+        case SOURCE_HEAP:
+            stil_free((void *)lexer->whole);
+            break;
+        case SOURCE_STREAM:
+            stil_free((void *)lexer->whole);
+            if(lexer->stream_fd != STDIN_FILENO) {
+                close(lexer->stream_fd);
+            }
+            break;
+        case SOURCE_STATIC:
+            break;
+    }
+    drop_line_index(lexer);
+    lexer->whole = NULL;
+    lexer->rest = NULL;
+}
+
+static inline Token make_token(TokenKind kind, size_t offset, size_t len) {
+    return (Token){.kind = kind, .offset = offset, .len = len};
 }
 
 static char peek_n(Lexer *l, size_t n) {
-    if(l->pos + n >= l->source_len) {
+    if(l->pos + n > l->source_len) {
         return '\0';
     }
     return l->rest[n - 1];
 }
 
 #define peek(lexer) peek_n(lexer, 1)
-/* #define just_tok(tok_kind) make_sym_token(tok_kind, curr_at, arena); */
-#define just_tok(tok_kind) make_sym_token(tok_kind, curr_at);
+#define just_tok(tok_kind) make_token(tok_kind, curr_at, lexer->pos - curr_at);
 
-/* Token *lexer_next_tok(Lexer *lexer, Arena *arena) { */
-Token *lexer_next_tok(Lexer *lexer) {
-    Token *tok = NULL;
+// The actual state machine. Both lexer_next_tok and lexer_tokenize_all
+// are thin wrappers that decide where the token ends up
+static Token lex_token(Lexer *lexer) {
     Started started = ST_None;
 
-    while(lexer->pos < lexer->source_len - 1) {
+    while(lexer->pos < lexer->source_len) {
+        const char *ws_end = scan_skip_ws(lexer->rest, source_end(lexer));
+        advance_n(lexer, ws_end - lexer->rest);
+        if(lexer->pos >= lexer->source_len) {
+            break;
+        }
+
         char curr = *lexer->rest;
         size_t curr_at = lexer->pos;
         const char *c_onwards = lexer->rest;
         advance(lexer);
 
         started = ST_None;
-        if(isspace(curr)) {
-            continue;
-        }
 
         switch(curr) {
             case ':':
@@ -92,6 +255,11 @@ Token *lexer_next_tok(Lexer *lexer) {
             case ';':
                 return just_tok(TOKEN_SEMICOLON);
             case '(':
+                if(peek(lexer) == '*') {
+                    advance(lexer);
+                    started = ST_BlockComment;
+                    break;
+                }
                 return just_tok(TOKEN_LPAREN);
             case ')':
                 return just_tok(TOKEN_RPAREN);
@@ -172,321 +340,331 @@ Token *lexer_next_tok(Lexer *lexer) {
                 } else if(isalpha(curr)) {
                     started = ST_Ident_or_Keyword;
                 } else {
-                    /* tok = arena_alloc(arena, sizeof *tok); */
-                    tok = stil_malloc(sizeof *tok);
-                    tok->kind = TOKEN_ILLEGAL;
-                    /* tok->string_val = arena_alloc(arena, 2); */
-                    tok->string_val = stil_malloc(2);
-                    tok->string_val[0] = curr;
-                    tok->string_val[1] = '\0';
-                    return tok;
+                    return just_tok(TOKEN_ILLEGAL);
                 }
         }
 
         switch(started) {
             case ST_String:
                 {
-                    const char *end = strchr(lexer->rest + 1, '\'');
-                    if(!end) {
-                        stil_warn(
+                    const char *end =
+                        scan_find_quote(lexer->rest, source_end(lexer));
+                    if(end == source_end(lexer)) {
+                        if(can_refill(lexer)) {
+                            lexer->need_more = true;
+                            return just_tok(TOKEN_EOF);
+                        }
+                        stil_warn_to(
+                            lexer->diag,
                             "Got ' but string literal is not properly closed");
                         continue;
                     }
 
-                    size_t s_len = (end - lexer->rest);
-                    /* tok = arena_alloc(arena, sizeof *tok); */
-                    tok = stil_malloc(sizeof *tok);
-                    tok->kind = TOKEN_LITERAL_STRING;
-                    tok->offset = curr_at;
-                    /* tok->string_val = arena_alloc(arena, s_len + 1); */
-                    tok->string_val = stil_malloc(s_len + 1);
-                    memcpy(tok->string_val, c_onwards + 1, s_len);
-                    tok->string_val[s_len] = '\0';
-
-                    lexer->pos += s_len;
-                    lexer->rest = end + 1;
+                    // the span keeps both quotes
+                    advance_n(lexer, end - lexer->rest + 1);
 
-                    return tok;
+                    return just_tok(TOKEN_LITERAL_STRING);
                 }
             case ST_WideString:
                 break;
             case ST_Number:
                 {
-                    bool got_dot = false;
-                    const char *first_non_digit = c_onwards;
-                    while(*first_non_digit &&
-                          (isdigit((unsigned char)*first_non_digit) ||
-                           (*first_non_digit == '.' && !got_dot))) {
-                        if(*first_non_digit == '.') {
-                            got_dot = true;
-                        }
-                        first_non_digit++;
+                    const char *end = source_end(lexer);
+                    const char *p = lexer->rest;
+                    while(p < end && isdigit((unsigned char)*p)) {
+                        p++;
                     }
 
-                    size_t first_non_digit_index = first_non_digit - c_onwards;
-                    size_t literal_len = first_non_digit_index;
-
-                    // ** Truncate if there is more than one dot **
-                    const char *dot1 = strchr(c_onwards, '.');
-                    if(dot1) {
-                        const char *dot2 = strchr(dot1 + 1, '.');
-                        if(dot2) {
-                            literal_len =
-                                dot1 - c_onwards; // Stop at the first dot
-                            got_dot = false;      // Treat as an integer
+                    // it's only a real if the dot has digits after it,
+                    // so 1..5 stays an int followed by a range
+                    bool got_dot = false;
+                    if(end - p >= 2 && *p == '.' &&
+                       isdigit((unsigned char)p[1])) {
+                        got_dot = true;
+                        p++;
+                        while(p < end && isdigit((unsigned char)*p)) {
+                            p++;
                         }
                     }
 
-                    /* Token *tok = arena_alloc(arena, sizeof *tok); */
-                    Token *tok = stil_malloc(sizeof *tok);
-                    tok->offset = curr_at;
-                    char num_buf[literal_len + 1];
-                    snprintf(num_buf, literal_len + 1, "%s", c_onwards);
-
-                    if(got_dot) {
-                        tok->kind = TOKEN_LITERAL_REAL;
-                        /* tok->float_val = strtod(num_buf, NULL); */
-                    } else {
-                        tok->kind = TOKEN_LITERAL_INTEGER;
-                        /* tok->int_val = atoi(num_buf); */
-                    }
-                    tok->string_val = strdup(num_buf);
-
-                    size_t extra_bytes = literal_len - 1;
-                    /* report(lexer, tok->offset, literal_len,
-                           "Got number literal"); */
-                    lexer->pos += extra_bytes;
-                    lexer->rest += extra_bytes;
-
-                    return tok;
+                    advance_n(lexer, p - lexer->rest);
+                    return just_tok(got_dot ? TOKEN_LITERAL_REAL
+                                            : TOKEN_LITERAL_INTEGER);
                 }
                 break;
             case ST_Keyword:
                 break;
             case ST_Ident_or_Keyword:
                 {
-                    size_t remaining_len = 0;
-                    while(lexer->pos + remaining_len < lexer->source_len) {
-                        char c = lexer->rest[remaining_len];
-                        if(!is_st_ident_ch(c)) {
-                            break;
-                        }
-                        remaining_len++;
-                    }
+                    size_t remaining_len =
+                        scan_ident_end(lexer->rest, source_end(lexer)) -
+                        lexer->rest;
 
                     size_t total_len = remaining_len + 1;
-                    char *lexeme = stil_malloc(total_len + 1);
-                    memcpy(lexeme, c_onwards, total_len);
-                    lexeme[total_len] = '\0';
-
-                    /* tok = arena_alloc(arena, sizeof *tok); */
-                    tok = stil_malloc(sizeof *tok);
-                    tok->offset = curr_at;
-
-                    int kw =
-                        ht_get(lexer->kw_lookup, str_to_upper(strdup(lexeme)));
-                    if(kw == -1) {
-                        tok->kind = TOKEN_IDENT;
-                        tok->string_val = strdup(lexeme);
-                    } else {
-                        tok->kind = (TokenKind)kw;
-                    }
 
-                    lexer->pos += total_len - 1;
-                    lexer->rest += remaining_len;
-                    free(lexeme);
-                    return tok;
+                    int kw = kw_lookup(c_onwards, total_len);
+                    advance_n(lexer, remaining_len);
+                    return just_tok(kw == -1 ? TOKEN_IDENT : (TokenKind)kw);
                 }
                 break;
             case ST_FSlash:
                 break;
             case ST_BlockComment:
-                break;
+                {
+                    // (* *) comments don't nest
+                    const char *close =
+                        scan_find_comment_end(lexer->rest, source_end(lexer));
+                    if(close == source_end(lexer)) {
+                        if(can_refill(lexer)) {
+                            lexer->need_more = true;
+                            return just_tok(TOKEN_EOF);
+                        }
+                        stil_warn_to(
+                            lexer->diag,
+                            "Got (* but comment is not properly closed");
+                        advance_n(lexer, close - lexer->rest);
+                        continue;
+                    }
+                    advance_n(lexer, close - lexer->rest + 2);
+                    continue;
+                }
             case ST_None:
                 stil_info("%c", curr);
                 break;
         }
     }
 
-    return NULL;
+    return make_token(TOKEN_EOF, lexer->pos, 0);
+}
+
+// Slides the window down to the current position and tops it up from the
+// fd. The window only grows when a single token doesn't fit in it
+static void stream_refill(Lexer *lexer) {
+    char *window = (char *)lexer->whole;
+
+    // line starts are offsets into the window, which is about to move
+    drop_line_index(lexer);
+
+    if(lexer->pos > 0) {
+        lexer->base_line += count_newlines(window, lexer->pos);
+        memmove(window, window + lexer->pos, lexer->source_len - lexer->pos);
+        lexer->base += lexer->pos;
+        lexer->source_len -= lexer->pos;
+        lexer->pos = 0;
+    } else if(lexer->source_len == lexer->window_cap) {
+        lexer->window_cap *= 2;
+        window = stil_realloc(window, lexer->window_cap);
+        lexer->whole = window;
+    }
+
+    while(true) {
+        ssize_t n = read(lexer->stream_fd, window + lexer->source_len,
+                         lexer->window_cap - lexer->source_len);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n < 0) {
+            stil_fatal("Couldn't read from %s: %s", lexer->source,
+                       strerror(errno));
+        }
+        if(n == 0) {
+            lexer->stream_eof = true;
+        }
+        lexer->source_len += n;
+        break;
+    }
+    lexer->rest = window + lexer->pos;
 }
-void report(Lexer *lexer, size_t offset, size_t len, const char *message) {
-    lexer->n_errors++;
-    const char *start = lexer->whole;
-    const char *curr = start + offset;
 
-    const char *line_start = curr;
-    while(line_start > start && *(line_start - 1) != '\n') {
-        line_start--;
+Token lexer_pull(Lexer *lexer) {
+    if(lexer->backing != SOURCE_STREAM) {
+        return lex_token(lexer);
     }
 
-    const char *line_end = curr;
-    while(*line_end && *line_end != '\n') {
-        line_end++;
+    while(true) {
+        Token tok = lex_token(lexer);
+        // Anything that ran into the end of the window, or whose lookahead
+        // might have, could have been cut short. It is lexed again once
+        // there is more input behind it
+        size_t tok_end = tok.offset + tok.len;
+        bool at_edge = lexer->need_more ||
+                       tok_end + LEX_STREAM_LOOKAHEAD >= lexer->source_len;
+        if(at_edge && can_refill(lexer)) {
+            lexer->need_more = false;
+            lexer->pos = tok.offset;
+            lexer->rest = lexer->whole + tok.offset;
+            stream_refill(lexer);
+            continue;
+        }
+
+        tok.offset += lexer->base;
+        return tok;
     }
+}
+
+Token *lexer_next_tok(Lexer *lexer, Arena *arena) {
+    Token *tok = arena_alloc(arena, sizeof *tok);
+    *tok = lexer_pull(lexer);
+    return tok;
+}
 
-    size_t column = curr - line_start;
+TokenBuffer *token_buffer_init(size_t cap) {
+    TokenBuffer *toks = stil_malloc(sizeof *toks);
+    toks->count = 0;
+    toks->cap = cap > 0 ? cap : 16;
+    toks->kinds = stil_malloc(toks->cap * sizeof(TokenKind));
+    toks->offsets = stil_malloc(toks->cap * sizeof(uint32_t));
+    toks->lens = stil_malloc(toks->cap * sizeof(uint32_t));
+    return toks;
+}
 
-    // previous and next lines
-    const char *prev_line_end = (line_start > start) ? line_start - 1 : NULL;
-    const char *next_line_start = (*line_end) ? line_end + 1 : NULL;
+void token_buffer_push(TokenBuffer *toks, Token tok) {
+    if(toks->count == toks->cap) {
+        toks->cap *= 2;
+        toks->kinds = stil_realloc(toks->kinds, toks->cap * sizeof(TokenKind));
+        toks->offsets =
+            stil_realloc(toks->offsets, toks->cap * sizeof(uint32_t));
+        toks->lens = stil_realloc(toks->lens, toks->cap * sizeof(uint32_t));
+    }
+    toks->kinds[toks->count] = tok.kind;
+    toks->offsets[toks->count] = (uint32_t)tok.offset;
+    toks->lens[toks->count] = (uint32_t)tok.len;
+    toks->count++;
+}
 
-    size_t line_number = 1;
-    for(const char *ptr = start; ptr < line_start; ptr++) {
-        if(*ptr == '\n') {
-            line_number++;
+bool lexer_tokenize_span(const Lexer *lexer, size_t start, size_t end,
+                         TokenBuffer *toks) {
+    // a private cursor over the same source so that spans of one file can
+    // be lexed side by side. Offsets stay relative to the whole file
+    Lexer view = *lexer;
+    view.pos = start;
+    view.rest = view.whole + start;
+    view.source_len = end;
+
+    while(true) {
+        Token tok = lex_token(&view);
+        if(tok.kind == TOKEN_EOF) {
+            // a NUL byte ends the file early, just like it does in C
+            if(tok.offset < end) {
+                token_buffer_push(toks, tok);
+                return true;
+            }
+            return false;
         }
+        token_buffer_push(toks, tok);
     }
+}
 
-    printf(ANSI_BOLD ANSI_RED "Error: " ANSI_RESET ANSI_BRIGHT_RED "%s%s\n",
-           message, ANSI_RESET);
-    printf(ANSI_BOLD ANSI_BRIGHT_BLUE "--> " ANSI_RESET "%s:%zu\n",
-           lexer->source, line_number);
+bool lexer_tokenize_until(const Lexer *lexer, size_t start, size_t stop,
+                          TokenBuffer *toks) {
+    Lexer view = *lexer;
+    view.pos = start;
+    view.rest = view.whole + start;
+
+    while(true) {
+        Token tok = lex_token(&view);
+        token_buffer_push(toks, tok);
+        if(tok.kind == TOKEN_EOF) {
+            return true;
+        }
+        if(tok.offset >= stop) {
+            return false;
+        }
+    }
+}
+
+void lexer_check_tokenizable(Lexer *lexer) {
+    if(lexer->source_len > UINT32_MAX) {
+        stil_fatal("%s is too large to tokenize in one go", lexer->source);
+    }
+}
+
+TokenBuffer *lexer_tokenize_all(Lexer *lexer) {
+    lexer_check_tokenizable(lexer);
+
+    // roughly one token per 6 bytes on typical ST, so most files never grow
+    TokenBuffer *toks = token_buffer_init(lexer->source_len / 6 + 16);
+    if(!lexer_tokenize_span(lexer, 0, lexer->source_len, toks)) {
+        token_buffer_push(toks, make_token(TOKEN_EOF, lexer->source_len, 0));
+    }
+    lexer->pos = lexer->source_len;
+    lexer->rest = source_end(lexer);
+
+    return toks;
+}
+
+void token_buffer_deinit(TokenBuffer *toks) {
+    stil_free(toks->kinds);
+    stil_free(toks->offsets);
+    stil_free(toks->lens);
+    stil_free(toks);
+}
+
+void report(Lexer *lexer, size_t offset, size_t len, const char *message) {
+    lexer->n_errors++;
+    FILE *out = lexer->diag;
+    if(lexer->error_starts) {
+        long at = ftell(out);
+        offset_list_push(lexer->error_starts, at > 0 ? (size_t)at : 0);
+    }
+
+    // a streaming lexer may have already let go of that part of the input
+    if(offset < lexer->base) {
+        fprintf(out,
+                ANSI_BOLD ANSI_RED "Error: " ANSI_RESET ANSI_BRIGHT_RED
+                                   "%s%s\n",
+                message, ANSI_RESET);
+        fprintf(out, ANSI_BOLD ANSI_BRIGHT_BLUE "--> " ANSI_RESET "%s@%zu\n",
+                lexer->source, offset);
+        return;
+    }
+
+    const char *start = lexer->whole;
+    size_t column;
+    size_t line_number = lexer_line_col(lexer, offset, &column);
+    size_t idx = line_number - 1 - lexer->base_line;
+
+    const char *line_start = start + lexer->line_starts[idx];
+    const char *line_end = start + line_end_of(lexer, idx);
+
+    fprintf(out,
+            ANSI_BOLD ANSI_RED "Error: " ANSI_RESET ANSI_BRIGHT_RED "%s%s\n",
+            message, ANSI_RESET);
+    fprintf(out, ANSI_BOLD ANSI_BRIGHT_BLUE "--> " ANSI_RESET "%s:%zu\n",
+            lexer->source, line_number);
 
     // alignment of line numbers
-    size_t num_width = snprintf(NULL, 0, "%zu", line_number + 1);
+    int num_width = snprintf(NULL, 0, "%zu", line_number + 1);
 
-    if(prev_line_end) {
-        const char *prev_line_start = prev_line_end;
-        while(prev_line_start > start && *(prev_line_start - 1) != '\n') {
-            prev_line_start--;
-        }
-        size_t prev_line_number = line_number - 1;
-        printf(ANSI_BRIGHT_BLUE "%*zu |" ANSI_RESET " %.*s", (int)num_width,
-               prev_line_number, (int)(prev_line_end - prev_line_start + 1),
-               prev_line_start);
+    // previous and next lines
+    if(idx > 0) {
+        const char *prev_line_start = start + lexer->line_starts[idx - 1];
+        fprintf(out, ANSI_BRIGHT_BLUE "%*zu |" ANSI_RESET " %.*s", num_width,
+                line_number - 1, (int)(line_start - prev_line_start),
+                prev_line_start);
     }
 
-    printf(ANSI_BRIGHT_BLUE "%*zu |" ANSI_RESET " %.*s\n", (int)num_width,
-           line_number, (int)(line_end - line_start), line_start);
+    fprintf(out, ANSI_BRIGHT_BLUE "%*zu |" ANSI_RESET " %.*s\n", num_width,
+            line_number, (int)(line_end - line_start), line_start);
 
-    printf(ANSI_BRIGHT_BLUE "%*s | " ANSI_RESET, (int)num_width, "");
+    fprintf(out, ANSI_BRIGHT_BLUE "%*s | " ANSI_RESET, num_width, "");
     for(size_t i = 0; i < column; i++) {
-        putchar(' ');
+        fputc(' ', out);
     }
-    printf("%s", ANSI_BOLD ANSI_BRIGHT_RED);
+    fprintf(out, "%s", ANSI_BOLD ANSI_BRIGHT_RED);
     for(size_t i = 0; i < len; i++) {
-        putchar('^');
+        fputc('^', out);
+    }
+    fputc('\n', out);
+    fprintf(out, "%s", ANSI_RESET);
+
+    if(idx + 1 < lexer->n_lines) {
+        const char *next_line_start = start + lexer->line_starts[idx + 1];
+        const char *next_line_end = start + line_end_of(lexer, idx + 1);
+        fprintf(out, ANSI_BRIGHT_BLUE "%*zu |" ANSI_RESET " %.*s\n\n",
+                num_width, line_number + 1,
+                (int)(next_line_end - next_line_start), next_line_start);
     }
-    putchar('\n');
-    printf("%s", ANSI_RESET);
-
-    if(next_line_start) {
-        const char *next_line_end = next_line_start;
-        while(*next_line_end && *next_line_end != '\n') {
-            next_line_end++;
-        }
-        size_t next_line_number = line_number + 1;
-        printf(ANSI_BRIGHT_BLUE "%*zu |" ANSI_RESET " %.*s\n\n", (int)num_width,
-               next_line_number, (int)(next_line_end - next_line_start),
-               next_line_start);
-    }
-}
-
-static void fillup_keywords(kw_ht *table) {
-    ht_set(table, "PROGRAM", TOKEN_KEYWORD_PROGRAM);
-    ht_set(table, "CLASS", TOKEN_KEYWORD_CLASS);
-    ht_set(table, "END_CLASS", TOKEN_KEYWORD_END_CLASS);
-    ht_set(table, "ENDCLASS", TOKEN_KEYWORD_END_CLASS);
-    ht_set(table, "EXTENDS", TOKEN_KEYWORD_EXTENDS);
-    ht_set(table, "IMPLEMENTS", TOKEN_KEYWORD_IMPLEMENTS);
-    ht_set(table, "INTERFACE", TOKEN_KEYWORD_INTERFACE);
-    ht_set(table, "END_INTERFACE", TOKEN_KEYWORD_END_INTERFACE);
-    ht_set(table, "ENDINTERFACE", TOKEN_KEYWORD_END_INTERFACE);
-    ht_set(table, "PROPERTY", TOKEN_KEYWORD_PROPERTY);
-    ht_set(table, "END_PROPERTY", TOKEN_KEYWORD_END_PROPERTY);
-    ht_set(table, "ENDPROPERTY", TOKEN_KEYWORD_END_PROPERTY);
-    ht_set(table, "VAR_INPUT", TOKEN_KEYWORD_VAR_INPUT);
-    ht_set(table, "VARINPUT", TOKEN_KEYWORD_VAR_INPUT);
-    ht_set(table, "VAR_OUTPUT", TOKEN_KEYWORD_VAR_OUTPUT);
-    ht_set(table, "VAROUTPUT", TOKEN_KEYWORD_VAR_OUTPUT);
-    ht_set(table, "VAR", TOKEN_KEYWORD_VAR);
-    ht_set(table, "VAR_CONFIG", TOKEN_KEYWORD_VAR_CONFIG);
-    ht_set(table, "ABSTRACT", TOKEN_KEYWORD_ABSTRACT);
-    ht_set(table, "FINAL", TOKEN_KEYWORD_FINAL);
-    ht_set(table, "METHOD", TOKEN_KEYWORD_METHOD);
-    ht_set(table, "CONSTANT", TOKEN_KEYWORD_CONSTANT);
-    ht_set(table, "RETAIN", TOKEN_KEYWORD_RETAIN);
-    ht_set(table, "NON_RETAIN", TOKEN_KEYWORD_NON_RETAIN);
-    ht_set(table, "NONRETAIN", TOKEN_KEYWORD_NON_RETAIN);
-    ht_set(table, "VAR_TEMP", TOKEN_KEYWORD_VAR_TEMP);
-    ht_set(table, "VARTEMP", TOKEN_KEYWORD_VAR_TEMP);
-    ht_set(table, "END_METHOD", TOKEN_KEYWORD_END_METHOD);
-    ht_set(table, "ENDMETHOD", TOKEN_KEYWORD_END_METHOD);
-    ht_set(table, "PUBLIC", TOKEN_KEYWORD_ACCESS_PUBLIC);
-    ht_set(table, "PRIVATE", TOKEN_KEYWORD_ACCESS_PRIVATE);
-    ht_set(table, "INTERNAL", TOKEN_KEYWORD_ACCESS_INTERNAL);
-    ht_set(table, "PROTECTED", TOKEN_KEYWORD_ACCESS_PROTECTED);
-    ht_set(table, "OVERRIDE", TOKEN_KEYWORD_OVERRIDE);
-    ht_set(table, "VAR_GLOBAL", TOKEN_KEYWORD_VAR_GLOBAL);
-    ht_set(table, "VARGLOBAL", TOKEN_KEYWORD_VAR_GLOBAL);
-    ht_set(table, "VAR_IN_OUT", TOKEN_KEYWORD_VAR_IN_OUT);
-    ht_set(table, "VARINOUT", TOKEN_KEYWORD_VAR_IN_OUT);
-    ht_set(table, "VAR_EXTERNAL", TOKEN_KEYWORD_VAR_EXTERNAL);
-    ht_set(table, "END_VAR", TOKEN_KEYWORD_END_VAR);
-    ht_set(table, "ENDVAR", TOKEN_KEYWORD_END_VAR);
-    ht_set(table, "END_PROGRAM", TOKEN_KEYWORD_END_PROGRAM);
-    ht_set(table, "ENDPROGRAM", TOKEN_KEYWORD_END_PROGRAM);
-    ht_set(table, "FUNCTION", TOKEN_KEYWORD_FUNCTION);
-    ht_set(table, "END_FUNCTION", TOKEN_KEYWORD_END_FUNCTION);
-    ht_set(table, "ENDFUNCTION", TOKEN_KEYWORD_END_FUNCTION);
-    ht_set(table, "FUNCTION_BLOCK", TOKEN_KEYWORD_FUNCTION_BLOCK);
-    ht_set(table, "FUNCTIONBLOCK", TOKEN_KEYWORD_FUNCTION_BLOCK);
-    ht_set(table, "END_FUNCTION_BLOCK", TOKEN_KEYWORD_END_FUNCTION_BLOCK);
-    ht_set(table, "ENDFUNCTIONBLOCK", TOKEN_KEYWORD_END_FUNCTION_BLOCK);
-    ht_set(table, "TYPE", TOKEN_KEYWORD_TYPE);
-    ht_set(table, "STRUCT", TOKEN_KEYWORD_STRUCT);
-    ht_set(table, "END_TYPE", TOKEN_KEYWORD_END_TYPE);
-    ht_set(table, "ENDTYPE", TOKEN_KEYWORD_END_TYPE);
-    ht_set(table, "END_STRUCT", TOKEN_KEYWORD_END_STRUCT);
-    ht_set(table, "ENDSTRUCT", TOKEN_KEYWORD_END_STRUCT);
-    ht_set(table, "ACTIONS", TOKEN_KEYWORD_ACTIONS);
-    ht_set(table, "ACTION", TOKEN_KEYWORD_ACTION);
-    ht_set(table, "END_ACTION", TOKEN_KEYWORD_END_ACTION);
-    ht_set(table, "ENDACTION", TOKEN_KEYWORD_END_ACTION);
-    ht_set(table, "END_ACTIONS", TOKEN_KEYWORD_END_ACTIONS);
-    ht_set(table, "ENDACTIONS", TOKEN_KEYWORD_END_ACTIONS);
-    ht_set(table, "IF", TOKEN_KEYWORD_IF);
-    ht_set(table, "THEN", TOKEN_KEYWORD_THEN);
-    ht_set(table, "ELSIF", TOKEN_KEYWORD_ELSE_IF);
-    ht_set(table, "ELSE", TOKEN_KEYWORD_ELSE);
-    ht_set(table, "END_IF", TOKEN_KEYWORD_END_IF);
-    ht_set(table, "ENDIF", TOKEN_KEYWORD_END_IF);
-    ht_set(table, "FOR", TOKEN_KEYWORD_FOR);
-    ht_set(table, "TO", TOKEN_KEYWORD_TO);
-    ht_set(table, "BY", TOKEN_KEYWORD_BY);
-    ht_set(table, "DO", TOKEN_KEYWORD_DO);
-    ht_set(table, "END_FOR", TOKEN_KEYWORD_END_FOR);
-    ht_set(table, "ENDFOR", TOKEN_KEYWORD_END_FOR);
-    ht_set(table, "WHILE", TOKEN_KEYWORD_WHILE);
-    ht_set(table, "END_WHILE", TOKEN_KEYWORD_END_WHILE);
-    ht_set(table, "ENDWHILE", TOKEN_KEYWORD_END_WHILE);
-    ht_set(table, "REPEAT", TOKEN_KEYWORD_REPEAT);
-    ht_set(table, "UNTIL", TOKEN_KEYWORD_UNTIL);
-    ht_set(table, "END_REPEAT", TOKEN_KEYWORD_END_REPEAT);
-    ht_set(table, "ENDREPEAT", TOKEN_KEYWORD_END_REPEAT);
-    ht_set(table, "CASE", TOKEN_KEYWORD_CASE);
-    ht_set(table, "RETURN", TOKEN_KEYWORD_RETURN);
-    ht_set(table, "EXIT", TOKEN_KEYWORD_EXIT);
-    ht_set(table, "CONTINUE", TOKEN_KEYWORD_CONTINUE);
-    ht_set(table, "POINTER", TOKEN_KEYWORD_POINTER);
-    ht_set(table, "REF_TO", TOKEN_KEYWORD_REFERENCE_TO);
-    ht_set(table, "REFTO", TOKEN_KEYWORD_REFERENCE_TO);
-    ht_set(table, "ARRAY", TOKEN_KEYWORD_ARRAY);
-    ht_set(table, "STRING", TOKEN_KEYWORD_STRING);
-    ht_set(table, "WSTRING", TOKEN_KEYWORD_WIDE_STRING);
-    ht_set(table, "OF", TOKEN_KEYWORD_OF);
-    ht_set(table, "AT", TOKEN_KEYWORD_AT);
-    ht_set(table, "END_CASE", TOKEN_KEYWORD_END_CASE);
-    ht_set(table, "ENDCASE", TOKEN_KEYWORD_END_CASE);
-    ht_set(table, "INT", TOKEN_KEYWORD_INT);
-    ht_set(table, "REAL", TOKEN_KEYWORD_REAL);
-
-    ht_set(table, "MOD", TOKEN_OPERATOR_MODULO);
-    ht_set(table, "AND", TOKEN_OPERATOR_AND);
-    ht_set(table, "OR", TOKEN_OPERATOR_OR);
-    ht_set(table, "XOR", TOKEN_OPERATOR_XOR);
-    ht_set(table, "NOT", TOKEN_OPERATOR_NOT);
 }
 
 static inline void advance(Lexer *l) {
@@ -494,18 +672,17 @@ static inline void advance(Lexer *l) {
     l->rest++;
 }
 
-static inline bool is_st_ident_ch(char c) {
-    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
-           (c >= '0' && c <= '9') || c == '_';
+static inline void advance_n(Lexer *l, size_t n) {
+    l->pos += n;
+    l->rest += n;
 }
 
-static char *str_to_upper(char *s) {
-    char *orig = s;
-    while(*s) {
-        *s = toupper((unsigned char)*s);
-        s++;
-    }
-    return orig;
+static inline const char *source_end(Lexer *l) {
+    return l->whole + l->source_len;
+}
+
+static inline bool can_refill(Lexer *l) {
+    return l->backing == SOURCE_STREAM && !l->stream_eof;
 }
 
 #define tok_str(kind, str)                                                     \
@@ -513,7 +690,25 @@ static char *str_to_upper(char *s) {
         strcat(buffer, str);                                                   \
         break
 
-char *tok_dbg(Token *token) {
+StrView tok_lexeme(Lexer *lexer, Token *token) {
+    return (StrView){.ptr = lexer->whole + (token->offset - lexer->base),
+                     .len = token->len};
+}
+
+static bool tok_shows_lexeme(TokenKind kind) {
+    switch(kind) {
+        case TOKEN_IDENT:
+        case TOKEN_LITERAL_STRING:
+        case TOKEN_LITERAL_INTEGER:
+        case TOKEN_LITERAL_REAL:
+        case TOKEN_ILLEGAL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+char *tok_dbg(Lexer *lexer, Token *token) {
     char buffer[256] = {0};
 
     switch(token->kind) {
@@ -631,6 +826,9 @@ char *tok_dbg(Token *token) {
 
         tok_str(TOKEN_KEYWORD_INT, "TYPE INT");
         tok_str(TOKEN_KEYWORD_REAL, "TYPE REAL");
+        tok_str(TOKEN_KEYWORD_BOOL, "TYPE BOOL");
+        tok_str(TOKEN_LITERAL_TRUE, "BOOL LITERAL: TRUE");
+        tok_str(TOKEN_LITERAL_FALSE, "BOOL LITERAL: FALSE");
 
         case TOKEN_PROPERTY_EXTERNAL:
         case TOKEN_PROPERTY_BY_REF:
@@ -640,8 +838,6 @@ char *tok_dbg(Token *token) {
         case TOKEN_LITERAL_INTEGER_OCT:
         case TOKEN_LITERAL_INTEGER_BIN:
         case TOKEN_LITERAL_NULL:
-        case TOKEN_LITERAL_TRUE:
-        case TOKEN_LITERAL_FALSE:
         case TOKEN_LITERAL_DATE:
         case TOKEN_LITERAL_DATE_AND_TIME:
         case TOKEN_LITERAL_TIME_OF_DAY:
@@ -654,8 +850,10 @@ char *tok_dbg(Token *token) {
             break;
     }
 
-    if(token->string_val) {
-        strcat(buffer, token->string_val);
+    if(tok_shows_lexeme(token->kind)) {
+        StrView lexeme = tok_lexeme(lexer, token);
+        size_t used = strlen(buffer);
+        snprintf(buffer + used, sizeof buffer - used, SV_FMT, SV_ARG(lexeme));
     }
     char *tstr = stil_malloc(256);
     tstr = strcpy(tstr, buffer);
@@ -2,18 +2,54 @@
 #define LEXER_H
 
 #include "arena.h"
-#include "ht.h"
 #include "shared.h"
+#include "vec.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+VEC_DEFINE(OffsetList, offset_list, size_t)
+
+// where Lexer->whole came from, which decides how it is released
+typedef enum _SourceBacking {
+    SOURCE_MAPPED,
+    SOURCE_HEAP,
+    SOURCE_STATIC,
+    SOURCE_STREAM,
+} SourceBacking;
+
+// a streaming lexer starts out with this much of its input in memory
+#define LEX_STREAM_WINDOW (64 * 1024)
+// no token needs to see further than this past its own end to be decided
+#define LEX_STREAM_LOOKAHEAD 4
 
 typedef struct _Lexer {
     const char *whole;
     const char *rest;
     const char *source;
-    kw_ht *kw_lookup;
     size_t pos;
     size_t source_len;
+    SourceBacking backing;
     int n_errors;
+    // where report() writes to, stdout unless someone wants to collect it
+    FILE *diag;
+    // When set, report() adds where in diag each error starts, so whoever
+    // collected it can cut it up by error afterwards
+    OffsetList *error_starts;
+
+    // Only used by streaming lexers. Their whole is a window that slides
+    // over the input, so base is the stream offset of whole[0] and
+    // base_line the number of newlines that already slid out of it
+    int stream_fd;
+    bool stream_eof;
+    bool need_more;
+    size_t window_cap;
+    size_t base;
+    size_t base_line;
+
+    // Offset of every line start in whole, built on the first lookup by
+    // lexer_line_col. A streaming lexer drops it whenever the window slides
+    size_t *line_starts;
+    size_t n_lines;
 } Lexer;
 
 typedef enum _TokenKind {
@@ -29,6 +65,7 @@ typedef enum _TokenKind {
     TOKEN_KEYWORD_INTERFACE,
     TOKEN_KEYWORD_INT,
     TOKEN_KEYWORD_REAL,
+    TOKEN_KEYWORD_BOOL,
     TOKEN_KEYWORD_END_INTERFACE,
     TOKEN_KEYWORD_PROPERTY,
     TOKEN_KEYWORD_END_PROPERTY,
@@ -163,10 +200,12 @@ typedef enum _DirectAccessType {
     DIRECT_ACCESS_TEMPLATE
 } DirectAccessType;
 
+// Tokens don't own their text. offset and len describe a span in
+// Lexer->whole that can be looked at through tok_lexeme
 typedef struct _Token {
     TokenKind kind;
     size_t offset;
-    char *string_val;
+    size_t len;
     /* union {
         int int_val;
         double float_val;
@@ -194,13 +233,68 @@ typedef struct _Token {
     }; */
 } Token;
 
-/* Lexer *lexer_init(const char *filepath, Arena *arena);
-Token *lexer_next_tok(Lexer *lexer, Arena *arena); */
-Lexer *lexer_init(const char *filepath);
-Token *lexer_next_tok(Lexer *lexer);
+// Every token the lexer hands out lives in the arena
+// so the whole token stream goes away with a single arena_reset
+// Lexer->whole is NOT NUL terminated, everything that reads it has to stay
+// within source_len
+// "-" reads stdin
+Lexer *lexer_init(const char *filepath, Arena *arena);
+// Reads the input through a fixed size window instead of holding all of it,
+// so memory stays flat however big the input is. Only tokens that have just
+// been pulled can be looked at with tok_lexeme.
+Lexer *lexer_init_stream(const char *filepath, Arena *arena);
+void lexer_deinit(Lexer *lexer);
+Token lexer_pull(Lexer *lexer);
+Token *lexer_next_tok(Lexer *lexer, Arena *arena);
+
+// The whole file lexed up front into parallel arrays.
+// The last token is always TOKEN_EOF
+typedef struct _TokenBuffer {
+    TokenKind *kinds;
+    uint32_t *offsets;
+    uint32_t *lens;
+    size_t count, cap;
+} TokenBuffer;
+
+TokenBuffer *lexer_tokenize_all(Lexer *lexer);
+// Same token stream as lexer_tokenize_all, but the source is cut into chunks
+// at newlines that sit between tokens and the chunks are lexed on n_threads
+// worker threads. See lexer-parallel.c
+TokenBuffer *lexer_tokenize_parallel(Lexer *lexer, int n_threads);
+
+// Lexes [start, end) of the source into toks without a trailing EOF.
+// Returns true if a NUL byte ended the source early, in which case the last
+// token pushed is that EOF. Doesn't move the lexer itself
+bool lexer_tokenize_span(const Lexer *lexer, size_t start, size_t end,
+                         TokenBuffer *toks);
+// Lexes from start, which has to be where a token starts, up to and
+// including the first token at or past stop. Gives up at the end of the
+// source instead, returning true with the EOF pushed
+bool lexer_tokenize_until(const Lexer *lexer, size_t start, size_t stop,
+                          TokenBuffer *toks);
+void lexer_check_tokenizable(Lexer *lexer);
+
+TokenBuffer *token_buffer_init(size_t cap);
+void token_buffer_push(TokenBuffer *toks, Token tok);
+void token_buffer_deinit(TokenBuffer *toks);
+
+static inline Token token_at(const TokenBuffer *toks, size_t idx) {
+    return (Token){
+        .kind = toks->kinds[idx],
+        .offset = toks->offsets[idx],
+        .len = toks->lens[idx],
+    };
+}
+StrView tok_lexeme(Lexer *lexer, Token *token);
 // void token_show(Token *token);
-char *tok_dbg(Token *token);
+char *tok_dbg(Lexer *lexer, Token *token);
 void report(Lexer *lexer, size_t offset, size_t len, const char *message);
+// 1 based line of a source offset, with the 0 based column written to column
+// if it isn't NULL. The offset has to still be in the lexer's window
+size_t lexer_line_col(Lexer *lexer, size_t offset, size_t *column);
+// Builds the line table up front. Lookups on a lexer whose table is built
+// only read it, so copies of that lexer can report from several threads
+void lexer_index_lines(Lexer *lexer);
 
 typedef enum _Started {
     ST_String,
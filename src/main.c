@@ -1,43 +1,371 @@
 #include "arena.h"
+#include "cache.h"
+#include "cgen.h"
+#include "driver.h"
+#include "flat-ast.h"
+#include "ir.h"
 #include "lexer.h"
 #include "parser.h"
+#include "reparse.h"
+#include "sema.h"
+#include "vm.h"
+#include <stdbool.h>
+#include <string.h>
 #include <time.h>
 
+// wall clock, clock() would add up the cpu time of every lexer thread
+static double now_secs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// machine readable, scripts/bench.py picks these up
+static void print_stats(size_t n_tokens, Arena *arena) {
+    printf("stat tokens %zu\n", n_tokens);
+    printf("stat allocs %zu\n", stil_alloc_count());
+    printf("stat arena_bytes %zu\n", arena->offset);
+    printf("stat interned %zu\n", intern_count());
+}
+
+// numbers only, so token streams can be diffed against each other
+static void print_token(const Token *tok) {
+    printf("%d %zu %zu\n", tok->kind, tok->offset, tok->len);
+}
+
+// Streams the input through the lexer without keeping it or its tokens
+// around, so this runs in constant memory for "-" however much is piped in.
+// With show_tokens every token goes to stdout as "kind offset len"
+static int lex_only(const char *filepath, int n_threads, bool show_tokens,
+                    bool stats) {
+    Arena arena = arena_init(1024 * 1024);
+    size_t n_tokens = 0;
+    double start = now_secs();
+
+    if(strcmp(filepath, "-") == 0) {
+        Lexer *lexer = lexer_init_stream(filepath, &arena);
+        Token tok;
+        do {
+            tok = lexer_pull(lexer);
+            if(show_tokens) {
+                print_token(&tok);
+            }
+            n_tokens++;
+        } while(tok.kind != TOKEN_EOF);
+        lexer_deinit(lexer);
+    } else {
+        Lexer *lexer = lexer_init(filepath, &arena);
+        TokenBuffer *tokens = n_threads > 1
+                                  ? lexer_tokenize_parallel(lexer, n_threads)
+                                  : lexer_tokenize_all(lexer);
+        n_tokens = tokens->count;
+        for(size_t i = 0; show_tokens && i < n_tokens; i++) {
+            Token tok = token_at(tokens, i);
+            print_token(&tok);
+        }
+        token_buffer_deinit(tokens);
+        lexer_deinit(lexer);
+    }
+
+    printf("Lexing time: %f seconds (%zu tokens)\n", now_secs() - start,
+           n_tokens);
+    if(stats) {
+        print_stats(n_tokens, &arena);
+    }
+    arena_deinit(&arena);
+    return 0;
+}
+
+// Runs the PROGRAM called name, or the first one there is, for n_cycles
+// scan cycles and prints where it ended up
+static void run_program(IRModule *module, const char *name, long n_cycles) {
+    InternId id = name ? intern_find(name, strlen(name)) : INTERN_NONE;
+    uint32_t program = UINT32_MAX;
+    for(size_t i = 0; i < module->funcs->count; i++) {
+        IRFunction func = ir_function_list_at(module->funcs, i);
+        if(func.kind == STUNIT_PROGRAM && (!name || func.name == id)) {
+            program = i;
+            break;
+        }
+    }
+    if(program == UINT32_MAX) {
+        stil_fatal(name ? "There's no PROGRAM called %s" : "There's no PROGRAM",
+                   name);
+    }
+
+    StilVM vm;
+    stil_vm_init(&vm, module, program);
+    if(vm.fault) {
+        stil_fatal("Initializing stopped: %s", vm.fault);
+    }
+    double start = now_secs();
+    for(long i = 0; i < n_cycles; i++) {
+        if(!stil_vm_cycle(&vm)) {
+            stil_fatal("Cycle %ld stopped: %s", i + 1, vm.fault);
+        }
+    }
+    double secs = now_secs() - start;
+
+    stil_vm_dump(&vm);
+    // not counting the RET
+    size_t n_insts = vm.code[program].count - 1;
+    printf("Run time: %f seconds (%ld cycles of %zu instructions, "
+           "%.2f ns per cycle)\n",
+           secs, n_cycles, n_insts, secs * 1e9 / n_cycles);
+    stil_vm_deinit(&vm);
+}
+
+// Writes the module out as C to c_path, or next to so_path if there's none,
+// and has that built into so_path if it's given
+static void emit_shared(IRModule *module, const char *source,
+                        const char *c_path, const char *so_path) {
+    char *tmp_path = NULL;
+    if(!c_path) {
+        tmp_path = stil_malloc(strlen(so_path) + 3);
+        sprintf(tmp_path, "%s.c", so_path);
+        c_path = tmp_path;
+    }
+
+    FILE *out = fopen(c_path, "w");
+    if(!out) {
+        stil_fatal("Couldn't write to %s", c_path);
+    }
+    cgen_emit(module, source, out);
+    if(fclose(out) != 0) {
+        stil_fatal("Couldn't write to %s", c_path);
+    }
+    stil_info("Wrote %s", c_path);
+
+    if(so_path) {
+        if(!cgen_build_shared(c_path, so_path)) {
+            stil_fatal("Couldn't build %s from %s", so_path, c_path);
+        }
+        stil_info("Built %s", so_path);
+    }
+    stil_free(tmp_path);
+}
+
+// Parses old_path, then brings the tree up to date with filepath through
+// reparse_compilation_unit, which is what an editor would do after an edit.
+// Only the second half gets timed
+static int reparse_only(const char *old_path, const char *filepath,
+                        int max_errors, bool dump, bool stats) {
+    Arena arena = arena_init(COMPILATION_ARENA_SIZE);
+    Lexer *old = lexer_init(old_path, &arena);
+    TokenBuffer *old_tokens = lexer_tokenize_all(old);
+    Parser *parser = parser_init(old, old_tokens, &arena);
+    CompilationUnit *comp_unit = parse_compilation_unit(parser);
+    token_buffer_deinit(old_tokens);
+    if(old->n_errors > 0) {
+        stil_fatal("Can't reparse from %s, it has %d errors.", old_path,
+                   old->n_errors);
+    }
+
+    double start = now_secs();
+    Lexer *lexer = lexer_init(filepath, &arena);
+    lexer_check_tokenizable(lexer);
+    ReparseStats reparse_stats;
+    comp_unit = reparse_compilation_unit(comp_unit, old, lexer, &arena,
+                                         max_errors, &reparse_stats);
+    // names are resolved across units, so that has to be done from scratch
+    if(lexer->n_errors == 0) {
+        sema_comp_unit(comp_unit, lexer, &arena, max_errors);
+    }
+    double end = now_secs();
+    if(lexer->n_errors > 0) {
+        stil_fatal("Couldn't compile due to %d errors.", lexer->n_errors);
+    }
+
+    if(dump) {
+        comp_unit_dump(comp_unit, lexer);
+    }
+    printf("Reparse time: %f seconds (%zu units reused, %zu reparsed)\n",
+           end - start, reparse_stats.reused, reparse_stats.reparsed);
+    if(stats) {
+        printf("stat reused_units %zu\n", reparse_stats.reused);
+        printf("stat reparsed_units %zu\n", reparse_stats.reparsed);
+        printf("stat relexed_bytes %zu\n", reparse_stats.relexed);
+    }
+
+    lexer_deinit(lexer);
+    lexer_deinit(old);
+    arena_deinit(&arena);
+    return 0;
+}
+
 int main(int argc, char **argv) {
-    if(argc < 2) {
-        /* stil_fatal("Usage: stil <filename>"); */
+    const char *inputs[argc];
+    size_t n_inputs = 0;
+    int n_threads = 1;
+    bool lex = false;
+    bool show_tokens = false;
+    bool dump = true;
+    bool stats = false;
+    bool flat = false;
+    bool ir = false;
+    bool use_cache = true;
+    const char *reparse_from = NULL;
+    long run_cycles = 0;
+    const char *program = NULL;
+    const char *c_path = NULL;
+    const char *so_path = NULL;
+    int max_errors = PARSER_DEFAULT_MAX_ERRORS;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            n_threads = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--lex") == 0) {
+            lex = true;
+        } else if(strcmp(argv[i], "--tokens") == 0) {
+            lex = show_tokens = true;
+        } else if(strcmp(argv[i], "--parse") == 0) {
+            dump = false;
+        } else if(strcmp(argv[i], "--stats") == 0) {
+            stats = true;
+        } else if(strcmp(argv[i], "--max-errors") == 0 && i + 1 < argc) {
+            max_errors = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--flat") == 0) {
+            flat = true;
+        } else if(strcmp(argv[i], "--ir") == 0) {
+            ir = true;
+        } else if(strcmp(argv[i], "--reparse-from") == 0 && i + 1 < argc) {
+            reparse_from = argv[++i];
+        } else if(strcmp(argv[i], "--no-cache") == 0) {
+            use_cache = false;
+        } else if(strcmp(argv[i], "--run") == 0 && i + 1 < argc) {
+            run_cycles = atol(argv[++i]);
+        } else if(strcmp(argv[i], "--program") == 0 && i + 1 < argc) {
+            program = argv[++i];
+        } else if(strcmp(argv[i], "--emit-c") == 0 && i + 1 < argc) {
+            c_path = argv[++i];
+        } else if(strcmp(argv[i], "--shared") == 0 && i + 1 < argc) {
+            so_path = argv[++i];
+        } else {
+            inputs[n_inputs++] = argv[i];
+        }
+    }
+
+    if(n_inputs > 1 || (n_inputs == 1 && driver_is_project(inputs[0]))) {
+        if(run_cycles > 0 || c_path || so_path) {
+            stil_fatal("--run, --emit-c and --shared take a single file");
+        }
+        DriverOptions opts = {
+            .n_threads = n_threads,
+            .lex = lex,
+            .dump = dump,
+            .flat = flat,
+            .ir = ir,
+            .stats = stats,
+            .max_errors = max_errors,
+            .cache_dir = use_cache ? cache_dir() : NULL,
+        };
+        size_t n_failed = driver_build(inputs, n_inputs, &opts);
+        if(n_failed > 0) {
+            stil_fatal("Couldn't compile %zu files.", n_failed);
+        }
+        return 0;
+    }
+
+    const char *filepath = n_inputs == 1 ? inputs[0] : NULL;
+    if(!filepath) {
+        /* stil_fatal("Usage: stil [-j threads] [--lex | --tokens | --parse] "
+                      "[--flat] "
+                      "[--ir] [--max-errors N] [--stats] [--no-cache] "
+                      "[--run cycles] [--program name] "
+                      "[--emit-c out.c] [--shared out.so] "
+                      "[--reparse-from old_file] "
+                      "<filename | dir | @manifest ...>"); */
         stil_warn("No file arg provided. Using sample file");
+        /* filepath = "testdata/class_method.st"; */
+        filepath = "testdata/simple_program.st";
+    }
+
+    if(lex) {
+        return lex_only(filepath, n_threads, show_tokens, stats);
+    }
+    if(reparse_from) {
+        return reparse_only(reparse_from, filepath, max_errors, dump, stats);
     }
 
-    /* const char *filepath = argc < 2 ? "testdata/class_method.st" : argv[1];
-     */
-    const char *filepath = argc < 2 ? "testdata/simple_program.st" : argv[1];
+    // the whole tree for the compilation lives in here
+    Arena arena = arena_init(COMPILATION_ARENA_SIZE);
+    Lexer *lexer = lexer_init(filepath, &arena);
 
-    Arena arena = arena_init(64 * 1024 * 1024);
-    /* Lexer *lexer = lexer_init(filepath, &arena); */
-    Lexer *lexer = lexer_init(filepath);
-    Parser *parser = parser_init(lexer);
-    /* ASTNode *root = parse(parser); */
-    clock_t start = clock();
-    CompilationUnit *comp_unit = parse_compilation_unit(parser);
+    double start = now_secs();
+    TokenBuffer *tokens = n_threads > 1
+                              ? lexer_tokenize_parallel(lexer, n_threads)
+                              : lexer_tokenize_all(lexer);
+    double lexed = now_secs();
 
-    /* Token *t = lexer_next_tok(lexer, &arena); */
-    /* Token *t = lexer_next_tok(lexer);
-    while(t) {
-        stil_info("%s", tok_dbg(t));
-        // t = lexer_next_tok(lexer, &arena);
-        t = lexer_next_tok(lexer);
+    /* for(size_t i = 0; i < tokens->count; i++) {
+        Token t = token_at(tokens, i);
+        stil_info("%s", tok_dbg(lexer, &t));
     } */
 
+    Parser *parser = parser_init(lexer, tokens, &arena);
+    parser->max_errors = max_errors;
+    /* ASTNode *root = parse(parser); */
+    CompilationUnit *comp_unit =
+        n_threads > 1 ? parse_compilation_unit_parallel(parser, n_threads)
+                      : parse_compilation_unit(parser);
+    double parsed = now_secs();
+    // a tree with syntax errors in it would only make for more errors
+    if(lexer->n_errors == 0) {
+        sema_comp_unit(comp_unit, lexer, &arena, max_errors);
+    }
+
     if(lexer->n_errors > 0) {
         stil_fatal("Couldn't compile due to %d errors.", lexer->n_errors);
     }
-    clock_t end = clock();
-    double time_spent = (double)(end - start) / CLOCKS_PER_SEC;
-    comp_unit_dump(comp_unit);
-    /* ast_dump(root); */
-    printf("Execution time: %f seconds\n", time_spent);
+    double end = now_secs();
+    double lex_time = lexed - start;
+    double parse_time = parsed - lexed;
+    double sema_time = end - parsed;
+    // the flat tree is built from the pointer one, so --flat is mostly
+    // there to check the two agree and to compare their sizes
+    FlatAST *flat_ast = flat ? flat_ast_from_comp_unit(comp_unit, lexer) : NULL;
+    double lowering = now_secs();
+    bool want_c = c_path || so_path;
+    IRModule *module = ir || run_cycles > 0 || want_c
+                           ? ir_lower(comp_unit, &arena)
+                           : NULL;
+    double lower_time = now_secs() - lowering;
+    if(want_c) {
+        emit_shared(module, filepath, c_path, so_path);
+    }
+    if(run_cycles > 0) {
+        run_program(module, program, run_cycles);
+    } else if(dump) {
+        if(module) {
+            ir_dump(module);
+        } else if(flat_ast) {
+            flat_ast_dump(flat_ast);
+        } else {
+            comp_unit_dump(comp_unit, lexer);
+        }
+        /* ast_dump(root, lexer); */
+    }
+    printf("Lexing time: %f seconds (%zu tokens)\n", lex_time, tokens->count);
+    printf("Parsing time: %f seconds\n", parse_time);
+    printf("Checking time: %f seconds\n", sema_time);
+    if(module) {
+        printf("Lowering time: %f seconds\n", lower_time);
+    }
+    printf("Execution time: %f seconds\n", lex_time + parse_time + sema_time);
+    if(stats) {
+        print_stats(tokens->count, &arena);
+        if(flat_ast) {
+            printf("stat flat_nodes %u\n", flat_ast->n_nodes);
+            printf("stat flat_bytes %zu\n", flat_ast_bytes(flat_ast));
+        }
+    }
 
+    if(flat_ast) {
+        flat_ast_deinit(flat_ast);
+    }
+    parser_deinit(parser);
+    token_buffer_deinit(tokens);
+    lexer_deinit(lexer);
     arena_deinit(&arena);
 
     return 0;
@@ -0,0 +1,208 @@
+#define _GNU_SOURCE
+#include "parser.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+// below this many tokens a run of units isn't worth handing to another thread
+#ifndef PARALLEL_PARSE_MIN_CHUNK
+#define PARALLEL_PARSE_MIN_CHUNK (64 * 1024)
+#endif
+// more chunks than threads so one slow chunk doesn't hold the rest up
+#define PARALLEL_PARSE_CHUNKS_PER_THREAD 4
+// like the compilation arena, only address space until it's used
+#define PARALLEL_PARSE_ARENA_SIZE ((size_t)4 * 1024 * 1024 * 1024)
+
+typedef struct _ParseChunk {
+    size_t start, end;
+    STUnitList *units;
+    // a copy with its own error count and diag stream, which keeps track of
+    // where each error starts in it
+    Lexer lexer;
+    char *diag;
+    size_t diag_len;
+} ParseChunk;
+
+typedef struct _ParseWorker {
+    Parser *parser;
+    Arena *arena;
+    ParseChunk *chunks;
+    size_t n_chunks;
+    atomic_size_t *next;
+} ParseWorker;
+
+/*
+ * A unit starts at PROGRAM, ACTION or CLASS, and the parser never lets a
+ * unit run past the start of the next one, so cutting the tokens right in
+ * front of those gives runs that parse exactly like they do as part of the
+ * whole file. Anything before the first unit goes with the first chunk.
+ */
+static size_t find_chunks(TokenBuffer *tokens, size_t n_chunks,
+                          size_t *starts) {
+    size_t target = tokens->count / n_chunks;
+    if(target < PARALLEL_PARSE_MIN_CHUNK) {
+        target = PARALLEL_PARSE_MIN_CHUNK;
+    }
+
+    size_t n = 1;
+    starts[0] = 0;
+    for(size_t i = target; i < tokens->count && n < n_chunks; i++) {
+        switch(tokens->kinds[i]) {
+            case TOKEN_KEYWORD_PROGRAM:
+            case TOKEN_KEYWORD_ACTION:
+            case TOKEN_KEYWORD_CLASS:
+                starts[n++] = i;
+                i += target - 1;
+                break;
+            default:
+                break;
+        }
+    }
+
+    return n;
+}
+
+static void parse_chunk(ParseWorker *worker, ParseChunk *chunk) {
+    Parser *parent = worker->parser;
+
+    chunk->lexer = *parent->lexer;
+    chunk->lexer.n_errors = 0;
+    chunk->lexer.error_starts = offset_list_init(NULL);
+    chunk->lexer.diag = open_memstream(&chunk->diag, &chunk->diag_len);
+    if(!chunk->lexer.diag) {
+        stil_fatal("Couldn't buffer parser errors");
+    }
+
+    Parser *parser = parser_init_span(&chunk->lexer, parent->tokens,
+                                      worker->arena, chunk->start, chunk->end);
+    // a chunk can't know how many errors came before it, so the limit gets
+    // applied when the chunks are put back together
+    parser->max_errors = 0;
+    chunk->units = st_unit_list_init(worker->arena);
+    parse_st_units(parser, chunk->units);
+
+    fclose(chunk->lexer.diag);
+}
+
+static void *parse_worker_run(void *arg) {
+    ParseWorker *worker = arg;
+    while(true) {
+        size_t i = atomic_fetch_add(worker->next, 1);
+        if(i >= worker->n_chunks) {
+            return NULL;
+        }
+        parse_chunk(worker, &worker->chunks[i]);
+    }
+}
+
+// Writes the first n errors in a chunk's diagnostics to out
+static void print_errors(ParseChunk *chunk, int n, FILE *out) {
+    OffsetList *starts = chunk->lexer.error_starts;
+    size_t end = (size_t)n < starts->count ? offset_list_at(starts, n)
+                                           : chunk->diag_len;
+    fwrite(chunk->diag, 1, end, out);
+}
+
+static void drop_errors(ParseChunk *chunk) {
+    free(chunk->diag);
+    offset_list_deinit(chunk->lexer.error_starts);
+}
+
+CompilationUnit *parse_compilation_unit_parallel(Parser *parser,
+                                                 int n_threads) {
+    TokenBuffer *tokens = parser->tokens;
+    size_t n_chunks = n_threads > 1 ? (size_t)n_threads : 1;
+    n_chunks *= PARALLEL_PARSE_CHUNKS_PER_THREAD;
+    size_t *starts = stil_malloc(n_chunks * sizeof *starts);
+    n_chunks = find_chunks(tokens, n_chunks, starts);
+    if(n_chunks <= 1 || parser->cursor != 0) {
+        stil_free(starts);
+        return parse_compilation_unit(parser);
+    }
+    if((size_t)n_threads > n_chunks) {
+        n_threads = n_chunks;
+    }
+
+    // the line table gets built lazily on the first error otherwise, and
+    // the workers all report through copies of this lexer
+    lexer_index_lines(parser->lexer);
+    fflush(parser->lexer->diag);
+
+    ParseChunk *chunks = stil_calloc(n_chunks, sizeof *chunks);
+    for(size_t i = 0; i < n_chunks; i++) {
+        chunks[i].start = starts[i];
+        chunks[i].end = i + 1 < n_chunks ? starts[i + 1] : tokens->count;
+    }
+    stil_free(starts);
+
+    atomic_size_t next = 0;
+    parser->n_worker_arenas = n_threads;
+    parser->worker_arenas = stil_malloc(n_threads * sizeof(Arena));
+    ParseWorker *workers = stil_malloc(n_threads * sizeof *workers);
+    pthread_t *threads = stil_malloc(n_threads * sizeof *threads);
+    for(int i = 0; i < n_threads; i++) {
+        parser->worker_arenas[i] = arena_init(PARALLEL_PARSE_ARENA_SIZE);
+        workers[i] = (ParseWorker){
+            .parser = parser,
+            .arena = &parser->worker_arenas[i],
+            .chunks = chunks,
+            .n_chunks = n_chunks,
+            .next = &next,
+        };
+    }
+
+    // the calling thread works through chunks like everyone else
+    for(int i = 1; i < n_threads; i++) {
+        if(pthread_create(&threads[i], NULL, parse_worker_run, &workers[i]) !=
+           0) {
+            stil_fatal("Couldn't spawn parser thread");
+        }
+    }
+    parse_worker_run(&workers[0]);
+    for(int i = 1; i < n_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    stil_free(workers);
+    stil_free(threads);
+
+    CompilationUnit *comp_unit = arena_alloc(parser->arena, sizeof *comp_unit);
+    comp_unit->st_units = st_unit_list_init(parser->arena);
+
+    // put everything back in source order, reporting errors the way one
+    // parser going through the whole file would have, limit included
+    Lexer *lexer = parser->lexer;
+    // lexer errors alone can use up the limit, then the parser says nothing
+    bool quiet = parser->max_errors > 0 &&
+                 lexer->n_errors >= parser->max_errors;
+    for(size_t i = 0; i < n_chunks; i++) {
+        ParseChunk *chunk = &chunks[i];
+        int n_errors = quiet ? 0 : chunk->lexer.n_errors;
+        bool hit_limit = !quiet && parser->max_errors > 0 &&
+                         lexer->n_errors + n_errors >= parser->max_errors;
+        if(hit_limit) {
+            n_errors = parser->max_errors - lexer->n_errors;
+        }
+        print_errors(chunk, n_errors, lexer->diag);
+        drop_errors(chunk);
+        lexer->n_errors += n_errors;
+
+        if(hit_limit) {
+            stil_warn_to(lexer->diag, "Stopping after %d errors",
+                         lexer->n_errors);
+            for(size_t j = i + 1; j < n_chunks; j++) {
+                drop_errors(&chunks[j]);
+            }
+            break;
+        }
+        for(size_t j = 0; j < chunk->units->count; j++) {
+            st_unit_list_push(comp_unit->st_units,
+                              st_unit_list_at(chunk->units, j));
+        }
+    }
+
+    stil_free(chunks);
+    parser->cursor = tokens->count - 1;
+    parser->curr_token = token_at(tokens, parser->cursor);
+    return comp_unit;
+}
@@ -1,32 +1,51 @@
 #include "parser.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
 #include <string.h>
 
-#define FAILED_EXPECTATION(expected)                                           \
-    stil_fatal("EXPECTED %s | RECEIVED %s", expected,                          \
-               tok_dbg(parser->curr_token))
-
 /* helpers */
-static Token *consume_token_and_clone(Parser *parser, TokenKind expected);
+static bool consume_token_and_take(Parser *parser, TokenKind expected,
+                                   Token *taken);
 static bool consume_token(Parser *parser, TokenKind expected);
 static ASTNode *str_from_ident(Token *ident);
 static bool fail_tok(Token *token);
 static void parser_advance(Parser *parser);
+static void parser_error(Parser *parser, const char *fmt, ...);
+static void expected(Parser *parser, const char *what);
+static bool at_sync_point(Parser *parser);
+static void sync_statement(Parser *parser);
+
+Parser *parser_init(Lexer *lexer, TokenBuffer *tokens, Arena *arena) {
+    return parser_init_span(lexer, tokens, arena, 0, tokens->count);
+}
 
-/* Parser *parser_init(Lexer *lexer, Arena *arena) { */
-Parser *parser_init(Lexer *lexer) {
-    /* Parser *parser = arena_alloc(arena, sizeof *parser); */
-    Parser *parser = stil_malloc(sizeof *parser);
+Parser *parser_init_span(Lexer *lexer, TokenBuffer *tokens, Arena *arena,
+                         size_t start, size_t end) {
+    Parser *parser = arena_alloc(arena, sizeof *parser);
     parser->lexer = lexer;
-    /* parser->curr_token = lexer_next_tok(lexer, arena); */
-    parser->curr_token = lexer_next_tok(lexer);
-    parser->peeked = lexer_next_tok(lexer);
-    /* parser->peeked = lexer_next_tok(lexer, arena); */
+    parser->arena = arena;
+    parser->tokens = tokens;
+    parser->cursor = start;
+    parser->end = end;
+    parser->curr_token = token_at(tokens, start);
+    parser->panicking = false;
+    parser->max_errors = PARSER_DEFAULT_MAX_ERRORS;
 
     return parser;
 }
 
-static inline ASTNode *make_node(NodeKind kind) {
-    ASTNode *node = stil_malloc(sizeof *node);
+void parser_deinit(Parser *parser) {
+    for(size_t i = 0; i < parser->n_worker_arenas; i++) {
+        arena_deinit(&parser->worker_arenas[i]);
+    }
+    stil_free(parser->worker_arenas);
+    parser->worker_arenas = NULL;
+    parser->n_worker_arenas = 0;
+}
+
+static inline ASTNode *make_node(Parser *parser, NodeKind kind) {
+    ASTNode *node = arena_alloc(parser->arena, sizeof *node);
     node->kind = kind;
     return node;
 }
@@ -39,6 +58,8 @@ TypeDecl type_from_token(Token *token) {
             return TYPE_INT;
         case TOKEN_KEYWORD_REAL:
             return TYPE_REAL;
+        case TOKEN_KEYWORD_BOOL:
+            return TYPE_BOOL;
         default:
             return NO_TYPE;
     }
@@ -59,64 +80,592 @@ TokenKind fail_for_unit(StUnitType ty) {
     }
 }
 
+// Lexemes aren't NUL terminated in the source, so ints go a digit at a time
+// rather than through strtol, which also catches one too big for an INT.
+// They're nothing but digits, the lexer makes sure of that
+static bool int_from_lexeme(StrView lexeme, int *out) {
+    int val = 0;
+    for(size_t i = 0; i < lexeme.len; i++) {
+        int digit = lexeme.ptr[i] - '0';
+        if(val > (INT_MAX - digit) / 10) {
+            return false;
+        }
+        val = val * 10 + digit;
+    }
+    *out = val;
+    return true;
+}
+
+// strtod wants it terminated, so it's copied out first. Reals are short,
+// but nothing stops one from going on for a page
+#define NUM_BUF_LEN 64
+
+static bool real_from_lexeme(StrView lexeme, double *out) {
+    char buf[NUM_BUF_LEN];
+    char *num = lexeme.len < sizeof buf ? buf : stil_malloc(lexeme.len + 1);
+    memcpy(num, lexeme.ptr, lexeme.len);
+    num[lexeme.len] = '\0';
+
+    char *end;
+    errno = 0;
+    *out = strtod(num, &end);
+    bool ok = errno != ERANGE && end == num + lexeme.len;
+    if(num != buf) {
+        stil_free(num);
+    }
+    return ok;
+}
+
+static void symbol_from_token(Parser *parser, Token *ident, Symbol *symbol) {
+    StrView lexeme = tok_lexeme(parser->lexer, ident);
+    symbol->id = intern(lexeme.ptr, lexeme.len);
+    symbol->offset = ident->offset;
+}
+
 Symbol *parse_symbol(Parser *parser) {
-    Token *ident = consume_token_and_clone(parser, TOKEN_IDENT);
-    if(!ident) {
-        stil_fatal("Expected IDENT got %s", tok_dbg(parser->curr_token));
+    Token ident;
+    if(!consume_token_and_take(parser, TOKEN_IDENT, &ident)) {
+        expected(parser, "a name");
+        return NULL;
     }
-    Symbol *symbol = stil_malloc(sizeof *symbol);
-    symbol->label = strdup(ident->string_val);
+    Symbol *symbol = arena_alloc(parser->arena, sizeof *symbol);
+    symbol_from_token(parser, &ident, symbol);
     return symbol;
 }
 
-ASTNode *parse_expr(Parser *parser) {
+/* expressions */
+
+/*
+ * Binding powers, loosest first. Each binary operator binds a bit tighter on
+ * its right than on its left so chains of the same operator group to the
+ * left. Prefix operators only have a right side and bind tighter than any
+ * binary one, so -a ** b is (-a) ** b like the standard says
+ */
+static InfixOperator infix_from_token(TokenKind kind) {
+    switch(kind) {
+        case TOKEN_OPERATOR_OR:
+            return OP_OR;
+        case TOKEN_OPERATOR_XOR:
+            return OP_XOR;
+        case TOKEN_OPERATOR_AND:
+        case TOKEN_OPERATOR_AMP:
+            return OP_AND;
+        case TOKEN_OPERATOR_EQ:
+            return OP_EQ;
+        case TOKEN_OPERATOR_NOT_EQ:
+            return OP_NE;
+        case TOKEN_OPERATOR_LESS_THAN:
+            return OP_LT;
+        case TOKEN_OPERATOR_LESS_THAN_EQ:
+            return OP_LTE;
+        case TOKEN_OPERATOR_GREATER_THAN:
+            return OP_GT;
+        case TOKEN_OPERATOR_GREATER_THAN_EQ:
+            return OP_GTE;
+        case TOKEN_OPERATOR_PLUS:
+            return OP_ADD;
+        case TOKEN_OPERATOR_MINUS:
+            return OP_SUB;
+        case TOKEN_OPERATOR_MULTIPLICATION:
+            return OP_MUL;
+        case TOKEN_OPERATOR_DIVISION:
+            return OP_DIV;
+        case TOKEN_OPERATOR_MODULO:
+            return OP_MOD;
+        case TOKEN_OPERATOR_EXPONENT:
+            return OP_POW;
+        default:
+            return NO_INFIX;
+    }
+}
+
+static Precedence infix_precedence(InfixOperator op) {
+    switch(op) {
+        case OP_OR:
+            return (Precedence){1, 2};
+        case OP_XOR:
+            return (Precedence){3, 4};
+        case OP_AND:
+            return (Precedence){5, 6};
+        case OP_EQ:
+        case OP_NE:
+            return (Precedence){7, 8};
+        case OP_LT:
+        case OP_LTE:
+        case OP_GT:
+        case OP_GTE:
+            return (Precedence){9, 10};
+        case OP_ADD:
+        case OP_SUB:
+            return (Precedence){11, 12};
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+            return (Precedence){13, 14};
+        case OP_POW:
+            return (Precedence){15, 16};
+        case NO_INFIX:
+            break;
+    }
+    return (Precedence){0, 0};
+}
+
+#define PREFIX_RIGHT_BIND 17
+
+static PrefixOperator prefix_from_token(TokenKind kind) {
+    switch(kind) {
+        case TOKEN_OPERATOR_MINUS:
+            return OP_NEG;
+        case TOKEN_OPERATOR_NOT:
+            return OP_NOT;
+        default:
+            return NO_PREFIX;
+    }
+}
+
+/* constant folding */
+
+static inline bool is_num_literal(ASTNode *node) {
+    return node->kind == ASTNODE_INT_LITERAL ||
+           node->kind == ASTNODE_REAL_LITERAL;
+}
+
+static inline double num_val(ASTNode *node) {
+    return node->kind == ASTNODE_INT_LITERAL ? node->int_literal.int_val
+                                             : node->real_literal.real_val;
+}
+
+static inline void set_int(ASTNode *node, unsigned val) {
+    node->kind = ASTNODE_INT_LITERAL;
+    node->int_literal.int_val = (int)val;
+}
+
+static inline void set_real(ASTNode *node, double val) {
+    node->kind = ASTNODE_REAL_LITERAL;
+    node->real_literal.real_val = val;
+}
+
+static inline void set_bool(ASTNode *node, bool val) {
+    node->kind = ASTNODE_BOOL_LITERAL;
+    node->bool_literal.bool_val = val;
+}
+
+// Integer math wraps like it would at runtime, which is why it's done on
+// unsigned. Anything that would trap or is left to the target, like dividing
+// by zero, stays unfolded
+static bool fold_int(InfixOperator op, int a, int b, ASTNode *out) {
+    unsigned ua = a, ub = b;
+    switch(op) {
+        case OP_ADD:
+            set_int(out, ua + ub);
+            return true;
+        case OP_SUB:
+            set_int(out, ua - ub);
+            return true;
+        case OP_MUL:
+            set_int(out, ua * ub);
+            return true;
+        case OP_DIV:
+        case OP_MOD:
+            if(b == 0 || (a == INT_MIN && b == -1)) {
+                return false;
+            }
+            set_int(out, op == OP_DIV ? a / b : a % b);
+            return true;
+        case OP_POW:
+            {
+                if(b < 0) {
+                    return false;
+                }
+                unsigned result = 1;
+                for(; ub; ub >>= 1, ua *= ua) {
+                    if(ub & 1) {
+                        result *= ua;
+                    }
+                }
+                set_int(out, result);
+                return true;
+            }
+        case OP_LT:
+            set_bool(out, a < b);
+            return true;
+        case OP_LTE:
+            set_bool(out, a <= b);
+            return true;
+        case OP_GT:
+            set_bool(out, a > b);
+            return true;
+        case OP_GTE:
+            set_bool(out, a >= b);
+            return true;
+        case OP_EQ:
+            set_bool(out, a == b);
+            return true;
+        case OP_NE:
+            set_bool(out, a != b);
+            return true;
+        case OP_AND:
+        case OP_OR:
+        case OP_XOR:
+            // only on BOOL, left alone so sema still says so
+        case NO_INFIX:
+            break;
+    }
+    return false;
+}
+
+static bool fold_real(InfixOperator op, double a, double b, ASTNode *out) {
+    switch(op) {
+        case OP_ADD:
+            set_real(out, a + b);
+            return true;
+        case OP_SUB:
+            set_real(out, a - b);
+            return true;
+        case OP_MUL:
+            set_real(out, a * b);
+            return true;
+        case OP_DIV:
+            if(b == 0.0) {
+                return false;
+            }
+            set_real(out, a / b);
+            return true;
+        case OP_LT:
+            set_bool(out, a < b);
+            return true;
+        case OP_LTE:
+            set_bool(out, a <= b);
+            return true;
+        case OP_GT:
+            set_bool(out, a > b);
+            return true;
+        case OP_GTE:
+            set_bool(out, a >= b);
+            return true;
+        case OP_EQ:
+            set_bool(out, a == b);
+            return true;
+        case OP_NE:
+            set_bool(out, a != b);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool fold_bool(InfixOperator op, bool a, bool b, ASTNode *out) {
+    switch(op) {
+        case OP_AND:
+            set_bool(out, a && b);
+            return true;
+        case OP_OR:
+            set_bool(out, a || b);
+            return true;
+        case OP_XOR:
+        case OP_NE:
+            set_bool(out, a != b);
+            return true;
+        case OP_EQ:
+            set_bool(out, a == b);
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Folds lhs op rhs into lhs if both are literals. rhs is left behind in the
+// arena, it's small and goes away with the rest of the tree
+static bool fold_binary(InfixOperator op, ASTNode *lhs, ASTNode *rhs) {
+    if(lhs->kind == ASTNODE_INT_LITERAL && rhs->kind == ASTNODE_INT_LITERAL) {
+        return fold_int(op, lhs->int_literal.int_val, rhs->int_literal.int_val,
+                        lhs);
+    }
+    if(is_num_literal(lhs) && is_num_literal(rhs)) {
+        return fold_real(op, num_val(lhs), num_val(rhs), lhs);
+    }
+    if(lhs->kind == ASTNODE_BOOL_LITERAL &&
+       rhs->kind == ASTNODE_BOOL_LITERAL) {
+        return fold_bool(op, lhs->bool_literal.bool_val,
+                         rhs->bool_literal.bool_val, lhs);
+    }
+    return false;
+}
+
+static bool fold_unary(PrefixOperator op, ASTNode *operand) {
+    switch(operand->kind) {
+        case ASTNODE_INT_LITERAL:
+            if(op != OP_NEG) {
+                return false;
+            }
+            set_int(operand, -(unsigned)operand->int_literal.int_val);
+            return true;
+        case ASTNODE_REAL_LITERAL:
+            if(op != OP_NEG) {
+                return false;
+            }
+            set_real(operand, -operand->real_literal.real_val);
+            return true;
+        case ASTNODE_BOOL_LITERAL:
+            if(op != OP_NOT) {
+                return false;
+            }
+            set_bool(operand, !operand->bool_literal.bool_val);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static ASTNode *make_binary(Parser *parser, InfixOperator op, ASTNode *lhs,
+                            ASTNode *rhs) {
+    if(fold_binary(op, lhs, rhs)) {
+        return lhs;
+    }
+    ASTNode *node = make_node(parser, ASTNODE_BINARY_EXPR);
+    node->binary_expr = (BinaryExpr){.op = op, .lhs = lhs, .rhs = rhs};
+    return node;
+}
+
+static ASTNode *make_unary(Parser *parser, PrefixOperator op,
+                           ASTNode *operand) {
+    if(fold_unary(op, operand)) {
+        return operand;
+    }
+    ASTNode *node = make_node(parser, ASTNODE_UNARY_EXPR);
+    node->unary_expr = (UnaryExpr){.op = op, .operand = operand};
+    return node;
+}
+
+/*
+ * Expressions are parsed without recursion. Operands and pending operators
+ * sit on two explicit stacks, and an operator gets applied to the operands
+ * under it as soon as the next operator binds looser than it does. That's
+ * the same thing a recursive Pratt parser does with its call stack, so
+ * nesting depth only costs heap.
+ */
+
+typedef enum _ExprOpKind {
+    EXPR_OP_INFIX,
+    EXPR_OP_PREFIX,
+    EXPR_OP_PAREN,
+} ExprOpKind;
+
+typedef struct _ExprOp {
+    ExprOpKind kind;
+    int op; // InfixOperator or PrefixOperator, depending on kind
+    int right_bind;
+} ExprOp;
+
+// enough for anything written by hand, generated code spills to the heap
+#define EXPR_STACK_INLINE 32
+
+typedef struct _ExprStacks {
+    ASTNode **operands;
+    size_t n_operands, operands_cap;
+    ExprOp *ops;
+    size_t n_ops, ops_cap;
+
+    ASTNode *operands_inline[EXPR_STACK_INLINE];
+    ExprOp ops_inline[EXPR_STACK_INLINE];
+} ExprStacks;
+
+static void *stack_grow(void *items, void *inline_items, size_t *cap,
+                        size_t item_size) {
+    size_t new_cap = *cap * 2;
+    if(items == inline_items) {
+        items = memcpy(stil_malloc(new_cap * item_size), items,
+                       *cap * item_size);
+    } else {
+        items = stil_realloc(items, new_cap * item_size);
+    }
+    *cap = new_cap;
+    return items;
+}
+
+static void push_operand(ExprStacks *st, ASTNode *node) {
+    if(st->n_operands == st->operands_cap) {
+        st->operands = stack_grow(st->operands, st->operands_inline,
+                                  &st->operands_cap, sizeof(ASTNode *));
+    }
+    st->operands[st->n_operands++] = node;
+}
+
+static void push_op(ExprStacks *st, ExprOp op) {
+    if(st->n_ops == st->ops_cap) {
+        st->ops =
+            stack_grow(st->ops, st->ops_inline, &st->ops_cap, sizeof(ExprOp));
+    }
+    st->ops[st->n_ops++] = op;
+}
+
+// applies the topmost operator to the operands it owns
+static void reduce(Parser *parser, ExprStacks *st) {
+    ExprOp op = st->ops[--st->n_ops];
+    ASTNode **top = &st->operands[st->n_operands - 1];
+
+    if(op.kind == EXPR_OP_PREFIX) {
+        *top = make_unary(parser, op.op, *top);
+    } else {
+        ASTNode *rhs = *top;
+        st->n_operands--;
+        top--;
+        *top = make_binary(parser, op.op, *top, rhs);
+    }
+}
+
+// reduces every operator binding at least as tight as left_bind, stopping
+// at an open paren
+static void reduce_while(Parser *parser, ExprStacks *st, int left_bind) {
+    while(st->n_ops > 0 && st->ops[st->n_ops - 1].kind != EXPR_OP_PAREN &&
+          st->ops[st->n_ops - 1].right_bind >= left_bind) {
+        reduce(parser, st);
+    }
+}
+
+// A single literal or name, or NULL if the current token can't be one
+static ASTNode *parse_operand(Parser *parser) {
     ASTNode *node = NULL;
+    StrView lexeme = tok_lexeme(parser->lexer, &parser->curr_token);
 
-    switch(parser->curr_token->kind) {
+    switch(parser->curr_token.kind) {
         case TOKEN_LITERAL_INTEGER:
             {
-                node = make_node(ASTNODE_INT_LITERAL);
-                IntLiteral *int_literal = stil_malloc(sizeof *int_literal);
-                int_literal->int_val = atoi(parser->curr_token->string_val);
-                node->int_literal = *int_literal;
+                int val;
+                if(!int_from_lexeme(lexeme, &val)) {
+                    parser_error(parser, "Literal out of range");
+                    return NULL;
+                }
+                node = make_node(parser, ASTNODE_INT_LITERAL);
+                node->int_literal.int_val = val;
                 break;
             }
         case TOKEN_LITERAL_REAL:
             {
-                node = make_node(ASTNODE_REAL_LITERAL);
-                RealLiteral *real_literal = stil_malloc(sizeof *real_literal);
-                real_literal->real_val =
-                    strtod(parser->curr_token->string_val, NULL);
-                node->real_literal = *real_literal;
+                double val;
+                if(!real_from_lexeme(lexeme, &val)) {
+                    parser_error(parser, "Literal out of range");
+                    return NULL;
+                }
+                node = make_node(parser, ASTNODE_REAL_LITERAL);
+                node->real_literal.real_val = val;
                 break;
             }
         case TOKEN_LITERAL_STRING:
-            {
-                node = make_node(ASTNODE_STR_LITERAL);
-                StrLiteral *str_literal = stil_malloc(sizeof *str_literal);
-                str_literal->str_val = strdup(parser->curr_token->string_val);
-                node->str_literal = *str_literal;
+            node = make_node(parser, ASTNODE_STR_LITERAL);
+            // strip the quotes
+            node->str_literal.str_val =
+                arena_strndup(parser->arena, lexeme.ptr + 1, lexeme.len - 2);
+            break;
+        case TOKEN_LITERAL_TRUE:
+        case TOKEN_LITERAL_FALSE:
+            node = make_node(parser, ASTNODE_BOOL_LITERAL);
+            node->bool_literal.bool_val =
+                parser->curr_token.kind == TOKEN_LITERAL_TRUE;
+            break;
+        case TOKEN_IDENT:
+            node = make_node(parser, ASTNODE_SYMBOL);
+            symbol_from_token(parser, &parser->curr_token, &node->symbol);
+            break;
+        default:
+            return NULL;
+    }
+
+    parser_advance(parser);
+    return node;
+}
+
+ASTNode *parse_expr(Parser *parser) {
+    ExprStacks st;
+    st.operands = st.operands_inline;
+    st.n_operands = 0;
+    st.operands_cap = EXPR_STACK_INLINE;
+    st.ops = st.ops_inline;
+    st.n_ops = 0;
+    st.ops_cap = EXPR_STACK_INLINE;
+
+    ASTNode *node = NULL;
+    bool want_operand = true;
+
+    while(true) {
+        TokenKind kind = parser->curr_token.kind;
+
+        if(want_operand) {
+            PrefixOperator prefix = prefix_from_token(kind);
+            if(prefix != NO_PREFIX) {
+                push_op(&st, (ExprOp){EXPR_OP_PREFIX, prefix,
+                                      PREFIX_RIGHT_BIND});
+            } else if(kind == TOKEN_OPERATOR_PLUS) {
+                // unary plus doesn't do anything
+            } else if(kind == TOKEN_LPAREN) {
+                push_op(&st, (ExprOp){EXPR_OP_PAREN, 0, 0});
+            } else {
+                ASTNode *operand = parse_operand(parser);
+                if(!operand) {
+                    expected(parser, "an expression");
+                    goto done;
+                }
+                push_operand(&st, operand);
+                want_operand = false;
+                continue;
+            }
+            parser_advance(parser);
+            continue;
+        }
+
+        InfixOperator infix = infix_from_token(kind);
+        if(infix != NO_INFIX) {
+            Precedence prec = infix_precedence(infix);
+            reduce_while(parser, &st, prec.left_bind);
+            push_op(&st, (ExprOp){EXPR_OP_INFIX, infix, prec.right_bind});
+            parser_advance(parser);
+            want_operand = true;
+            continue;
+        }
+
+        if(kind == TOKEN_RPAREN) {
+            reduce_while(parser, &st, 0);
+            if(st.n_ops == 0) {
+                // belongs to whatever the expression is nested in
                 break;
             }
-        default:
-            stil_warn("UNIMPLEMENTED");
-            break;
+            st.n_ops--; // the paren
+            parser_advance(parser);
+            continue;
+        }
+
+        break;
     }
 
-    if(node) {
-        parser_advance(parser);
+    reduce_while(parser, &st, 0);
+    if(st.n_ops > 0) {
+        expected(parser, "')'");
+        goto done;
+    }
+    node = st.operands[0];
+
+done:
+    if(st.operands != st.operands_inline) {
+        stil_free(st.operands);
+    }
+    if(st.ops != st.ops_inline) {
+        stil_free(st.ops);
     }
     return node;
 }
 
 ASTNode *parse_var_decl(Parser *parser) {
-    ASTNode *node = make_node(ASNTNODE_VAR_DECLARATION);
-    VarDeclaration *var_decl = stil_malloc(sizeof *var_decl);
-    var_decl->labels = symbol_list_init();
+    ASTNode *node = make_node(parser, ASNTNODE_VAR_DECLARATION);
+    VarDeclaration *var_decl = &node->var_decl;
+    var_decl->labels = symbol_list_init(parser->arena);
+    var_decl->type_name = NULL;
     var_decl->value = NULL;
 
     while(true) {
         Symbol *symbol = parse_symbol(parser);
+        if(!symbol) {
+            return NULL;
+        }
         symbol_list_push(var_decl->labels, symbol);
 
         if(consume_token(parser, TOKEN_COLON)) {
@@ -124,22 +673,34 @@ ASTNode *parse_var_decl(Parser *parser) {
         } else if(consume_token(parser, TOKEN_COMMA)) {
             continue;
         } else {
-            stil_fatal("Expected ASSIGN or COMMA");
+            expected(parser, "':' or ','");
+            return NULL;
         }
     }
 
-    var_decl->type = type_from_token(parser->curr_token);
-    parser_advance(parser);
+    var_decl->type = type_from_token(&parser->curr_token);
+    if(var_decl->type != NO_TYPE) {
+        parser_advance(parser);
+    } else if(parser->curr_token.kind == TOKEN_IDENT) {
+        // a named type, whether it exists is up to sema
+        var_decl->type_name = parse_symbol(parser);
+    } else {
+        expected(parser, "a type");
+        return NULL;
+    }
 
     if(consume_token(parser, TOKEN_ASSIGN)) {
         var_decl->value = parse_expr(parser);
+        if(!var_decl->value) {
+            return NULL;
+        }
     }
 
     if(!consume_token(parser, TOKEN_SEMICOLON)) {
-        FAILED_EXPECTATION(TOKEN_SEMICOLON);
+        expected(parser, "';'");
+        return NULL;
     }
 
-    node->var_decl = *var_decl;
     return node;
 }
 
@@ -161,21 +722,32 @@ VarBlockType block_type_from_token(Token *token) {
 }
 
 ASTNode *parse_declaration_block(Parser *parser) {
-    Token *block_type_tok = parser->curr_token;
+    Token *block_type_tok = &parser->curr_token;
     VarBlockType block_type = block_type_from_token(block_type_tok);
     parser_advance(parser);
 
-    ASTNode *node = make_node(ASNTNODE_VAR_DECLARATION_BLOCK);
-    VarBlock *var_block = stil_malloc(sizeof *var_block);
+    ASTNode *node = make_node(parser, ASNTNODE_VAR_DECLARATION_BLOCK);
+    VarBlock *var_block = &node->var_block;
     var_block->block_type = block_type;
-    var_block->var_decls = astnode_list_init();
+    var_block->var_decls = astnode_list_init(parser->arena);
 
     while(!consume_token(parser, TOKEN_KEYWORD_END_VAR)) {
+        if(at_sync_point(parser)) {
+            // whatever comes next is handled by the unit, END_VAR is
+            // most likely just missing
+            expected(parser, "END_VAR");
+            parser->panicking = false;
+            break;
+        }
+
         ASTNode *var_decl = parse_var_decl(parser);
-        astnode_list_push(var_block->var_decls, var_decl);
+        if(var_decl) {
+            astnode_list_push(var_block->var_decls, var_decl);
+        } else {
+            sync_statement(parser);
+        }
     }
 
-    node->var_block = *var_block;
     return node;
 }
 
@@ -193,59 +765,89 @@ StUnitType unit_type_from_token(Token *token) {
 }
 
 ASTNode *parse_statement(Parser *parser) {
-    ASTNode *node = make_node(ASTNODE_ASSIGNMENT_STMT);
-    Assignment *asgmt = stil_malloc(sizeof *asgmt);
+    ASTNode *node = make_node(parser, ASTNODE_ASSIGNMENT_STMT);
+    Assignment *asgmt = &node->asgmt;
 
     Symbol *name = parse_symbol(parser);
+    if(!name) {
+        return NULL;
+    }
     asgmt->name = name;
 
     if(!consume_token(parser, TOKEN_ASSIGN)) {
-        stil_fatal("Expected ASSIGN | Got %s", tok_dbg(parser->curr_token));
+        expected(parser, "':='");
+        return NULL;
     }
 
     ASTNode *value = parse_expr(parser);
+    if(!value) {
+        return NULL;
+    }
     asgmt->value = value;
 
     if(!consume_token(parser, TOKEN_SEMICOLON)) {
-        stil_fatal("Expected SEMICOLON | Got %s", tok_dbg(parser->curr_token));
+        expected(parser, "';'");
+        return NULL;
     }
 
-    node->asgmt = *asgmt;
     return node;
 }
 
-STUnit *parse_st_unit(Parser *parser) {
-    StUnitType unit_type = unit_type_from_token(parser->curr_token);
+static STUnit *parse_st_unit_body(Parser *parser) {
+    StUnitType unit_type = unit_type_from_token(&parser->curr_token);
     parser_advance(parser);
 
-    STUnit *unit = stil_malloc(sizeof *unit);
+    STUnit *unit = arena_alloc(parser->arena, sizeof *unit);
     unit->unit_type = unit_type;
-    unit->variable_blocks = astnode_list_init();
-    unit->statements = astnode_list_init();
+    unit->variable_blocks = astnode_list_init(parser->arena);
+    unit->statements = astnode_list_init(parser->arena);
 
     Symbol *unit_name = parse_symbol(parser);
     unit->name = unit_name;
+    if(!unit_name) {
+        sync_statement(parser);
+    }
     ASTNode *node = NULL;
     TokenKind end_tok = fail_for_unit(unit_type);
 
     while(!consume_token(parser, end_tok)) {
-        if(parser->curr_token->kind == TOKEN_EOF) {
-            stil_fatal("Reached end of file");
-        }
-
-        switch(parser->curr_token->kind) {
+        switch(parser->curr_token.kind) {
             case TOKEN_KEYWORD_VAR:
+            case TOKEN_KEYWORD_VAR_TEMP:
+            case TOKEN_KEYWORD_VAR_INPUT:
+            case TOKEN_KEYWORD_VAR_GLOBAL:
+            case TOKEN_KEYWORD_VAR_IN_OUT:
                 node = parse_declaration_block(parser);
                 astnode_list_push(unit->variable_blocks, node);
                 break;
 
             case TOKEN_IDENT:
                 node = parse_statement(parser);
-                astnode_list_push(unit->statements, node);
+                if(node) {
+                    astnode_list_push(unit->statements, node);
+                } else {
+                    sync_statement(parser);
+                }
                 break;
 
             default:
-                stil_fatal("Unexpected %s", tok_dbg(parser->curr_token));
+                if(fail_tok(&parser->curr_token) ||
+                   unit_type_from_token(&parser->curr_token) != NO_STUNIT) {
+                    // The unit was never closed properly. A mismatched end
+                    // is taken as its end, the start of the next unit is
+                    // left for the caller
+                    expected(parser, unit_type == STUNIT_PROGRAM
+                                         ? "END_PROGRAM"
+                                         : "END_ACTION");
+                    if(fail_tok(&parser->curr_token)) {
+                        parser_advance(parser);
+                    }
+                    parser->panicking = false;
+                    return unit;
+                }
+                parser_error(parser, "Unexpected token");
+                parser_advance(parser);
+                sync_statement(parser);
         }
     }
 
@@ -253,60 +855,74 @@ STUnit *parse_st_unit(Parser *parser) {
     return unit;
 }
 
-ASTNode *parse(Parser *parser) { return parse_declaration_block(parser); }
+STUnit *parse_st_unit(Parser *parser) {
+    size_t start = parser->curr_token.offset;
+    STUnit *unit = parse_st_unit_body(parser);
 
-CompilationUnit *parse_compilation_unit(Parser *parser) {
-    CompilationUnit *comp_unit = stil_malloc(sizeof *comp_unit);
-    /* comp_unit->st_units = astnode_list_init(); */
-    comp_unit->st_units = st_unit_list_init();
+    Token last = token_at(parser->tokens, parser->cursor - 1);
+    unit->span_start = start;
+    unit->span_end = last.offset + last.len;
+    unit->hash = stil_hash(parser->lexer->whole + start,
+                           unit->span_end - start, 0);
+    return unit;
+}
 
+ASTNode *parse(Parser *parser) { return parse_declaration_block(parser); }
+
+void parse_st_units(Parser *parser, STUnitList *units) {
     STUnit *unit = NULL;
 
-    while(parser->curr_token->kind != TOKEN_EOF) {
-        switch(parser->curr_token->kind) {
+    while(parser->cursor < parser->end &&
+          parser->curr_token.kind != TOKEN_EOF) {
+        switch(parser->curr_token.kind) {
             case TOKEN_KEYWORD_PROGRAM:
             case TOKEN_KEYWORD_ACTION:
                 /* node = parse_program(parser); */
                 unit = parse_st_unit(parser);
-                /* print_st_unit(unit, 0); */
+                /* print_st_unit(unit, parser->lexer, 0); */
                 break;
 
             default:
-                report(parser->lexer, parser->curr_token->offset, 1,
-                       "Unexpected token");
+                // nothing but a unit can start here, so skip to the next one
+                expected(parser, "PROGRAM or ACTION");
+                do {
+                    parser_advance(parser);
+                } while(parser->curr_token.kind != TOKEN_EOF &&
+                        unit_type_from_token(&parser->curr_token) ==
+                            NO_STUNIT);
+                parser->panicking = false;
+                continue;
         }
 
         /* astnode_list_push(comp_unit->s, node); */
 
-        stil_info("parsed unit %zu", comp_unit->st_units->count);
-        st_unit_list_push(comp_unit->st_units, unit);
-        stil_info("pushed unit %zu", comp_unit->st_units->count);
-
-        if(!parser->curr_token) {
-            break;
-        }
+        st_unit_list_push(units, unit);
     }
+}
 
+CompilationUnit *parse_compilation_unit(Parser *parser) {
+    CompilationUnit *comp_unit = arena_alloc(parser->arena, sizeof *comp_unit);
+    /* comp_unit->st_units = astnode_list_init(); */
+    comp_unit->st_units = st_unit_list_init(parser->arena);
+    parse_st_units(parser, comp_unit->st_units);
     return comp_unit;
 }
 
-static Token *consume_token_and_clone(Parser *parser, TokenKind expected) {
-    if(parser->curr_token->kind != expected) {
-        return NULL;
+// tokens are plain spans so handing out a copy costs nothing
+static bool consume_token_and_take(Parser *parser, TokenKind expected,
+                                   Token *taken) {
+    if(parser->curr_token.kind != expected) {
+        return false;
     }
 
-    Token *curr_token = stil_malloc(sizeof *curr_token);
-    *curr_token = *(parser->curr_token);
-    if(parser->curr_token->string_val) {
-        curr_token->string_val = strdup(parser->curr_token->string_val);
-    }
+    *taken = parser->curr_token;
 
     parser_advance(parser);
-    return curr_token;
+    return true;
 }
 
 static bool consume_token(Parser *parser, TokenKind expected) {
-    if(parser->curr_token->kind != expected) {
+    if(parser->curr_token.kind != expected) {
         return false;
     }
     parser_advance(parser);
@@ -328,7 +944,82 @@ static bool fail_tok(Token *token) {
     }
 }
 
+/* error recovery */
+
+// Reports at the current token, unless the parser is still skipping ahead
+// after an earlier error. Anything before the next sync point is most likely
+// fallout from that one and not worth reporting
+static void parser_error(Parser *parser, const char *fmt, ...) {
+    bool over_limit = parser->max_errors > 0 &&
+                      parser->lexer->n_errors >= parser->max_errors;
+    if(parser->panicking || over_limit) {
+        return;
+    }
+    parser->panicking = true;
+
+    char msg[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(msg, sizeof msg, fmt, args);
+    va_end(args);
+
+    Token *tok = &parser->curr_token;
+    report(parser->lexer, tok->offset, tok->len ? tok->len : 1, msg);
+
+    if(parser->max_errors > 0 &&
+       parser->lexer->n_errors >= parser->max_errors) {
+        stil_warn_to(parser->lexer->diag, "Stopping after %d errors",
+                     parser->lexer->n_errors);
+        // parking on EOF unwinds every loop in the parser
+        parser->cursor = parser->tokens->count - 1;
+        parser->curr_token = token_at(parser->tokens, parser->cursor);
+    }
+}
+
+static void expected(Parser *parser, const char *what) {
+    if(parser->curr_token.kind == TOKEN_EOF) {
+        parser_error(parser, "Expected %s, got end of file", what);
+        return;
+    }
+    StrView lexeme = tok_lexeme(parser->lexer, &parser->curr_token);
+    parser_error(parser, "Expected %s, got '" SV_FMT "'", what,
+                 SV_ARG(lexeme));
+}
+
+// Tokens a statement or declaration never runs past, since they start or
+// end something bigger than it
+static bool at_sync_point(Parser *parser) {
+    Token *tok = &parser->curr_token;
+    return fail_tok(tok) || block_type_from_token(tok) != NO_VARBLOCK ||
+           unit_type_from_token(tok) != NO_STUNIT ||
+           tok->kind == TOKEN_KEYWORD_END_VAR;
+}
+
+// Skips past the ';' ending the broken statement, or up to a sync point
+// if that comes first. Every token is looked at once so recovering never
+// costs more than parsing would have
+static void sync_statement(Parser *parser) {
+    while(!at_sync_point(parser)) {
+        if(consume_token(parser, TOKEN_SEMICOLON)) {
+            break;
+        }
+        parser_advance(parser);
+    }
+    parser->panicking = false;
+}
+
+// the last token is always EOF so the cursor just parks on it
 static void parser_advance(Parser *parser) {
-    parser->curr_token = parser->peeked;
-    parser->peeked = lexer_next_tok(parser->lexer);
+    if(parser->cursor + 1 < parser->tokens->count) {
+        parser->cursor++;
+    }
+    parser->curr_token = token_at(parser->tokens, parser->cursor);
+}
+
+static inline TokenKind parser_peek_kind(Parser *parser, size_t n) {
+    size_t idx = parser->cursor + n;
+    if(idx >= parser->tokens->count) {
+        return TOKEN_EOF;
+    }
+    return parser->tokens->kinds[idx];
 }
@@ -6,19 +6,46 @@
 
 typedef struct _Parser {
     Lexer *lexer;
-    Token *curr_token;
-    Token *peeked;
+    Arena *arena;
+    TokenBuffer *tokens;
+    size_t cursor;
+    Token curr_token; // == token_at(tokens, cursor)
+    // tokens from here on are someone else's to parse
+    size_t end;
+
+    // set from the first error until the parser gets back in step, so one
+    // mistake doesn't get reported over and over
+    bool panicking;
+    // parsing stops once the lexer has seen this many errors, 0 for no limit
+    int max_errors;
+
+    // one per worker of parse_compilation_unit_parallel, the units it
+    // hands back live in these
+    Arena *worker_arenas;
+    size_t n_worker_arenas;
 } Parser;
 
+#define PARSER_DEFAULT_MAX_ERRORS 50
+
 typedef struct _Chunk {
 } Chunk;
 
 typedef struct _Class {
 } Class;
 
-// Parser *init_parser(Lexer *lexer, Arena *arena);
-Parser *parser_init(Lexer *lexer);
+Parser *parser_init(Lexer *lexer, TokenBuffer *tokens, Arena *arena);
+// a parser that only looks at tokens [start, end)
+Parser *parser_init_span(Lexer *lexer, TokenBuffer *tokens, Arena *arena,
+                         size_t start, size_t end);
+// releases whatever the parser allocated outside of its arena
+void parser_deinit(Parser *parser);
 CompilationUnit *parse_compilation_unit(Parser *parser);
+// Parses units up to parser->end and pushes them onto units
+void parse_st_units(Parser *parser, STUnitList *units);
+// Same result as parse_compilation_unit, with the file cut into runs of
+// whole units that get parsed on n_threads threads. See parser-parallel.c
+CompilationUnit *parse_compilation_unit_parallel(Parser *parser,
+                                                 int n_threads);
 ASTNode *parse(Parser *parser);
 
 #endif
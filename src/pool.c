@@ -0,0 +1,168 @@
+#include "pool.h"
+#include "shared.h"
+#include <string.h>
+
+// set on worker threads, so a task knows which queue is its own
+static __thread Pool *current_pool = NULL;
+static __thread int current_worker = -1;
+
+typedef struct _PoolWorker {
+    Pool *pool;
+    int idx;
+} PoolWorker;
+
+// The counts only ever change with the queue's lock held as well as the
+// pool's, so a worker that sees n_queued > 0 is sure to find something
+static void queue_push(Pool *pool, PoolQueue *queue, PoolTask task) {
+    pthread_mutex_lock(&queue->lock);
+    if(queue->head > 0 && queue->tail == queue->cap) {
+        // slide everything back down before growing
+        size_t n = queue->tail - queue->head;
+        memmove(queue->tasks, queue->tasks + queue->head, n * sizeof(PoolTask));
+        queue->head = 0;
+        queue->tail = n;
+    }
+    if(queue->tail == queue->cap) {
+        queue->cap = queue->cap ? queue->cap * 2 : 16;
+        queue->tasks =
+            stil_realloc(queue->tasks, queue->cap * sizeof(PoolTask));
+    }
+    queue->tasks[queue->tail++] = task;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->n_queued++;
+    pool->n_unfinished++;
+    pthread_cond_signal(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static bool queue_take(Pool *pool, PoolQueue *queue, bool steal,
+                       PoolTask *task) {
+    pthread_mutex_lock(&queue->lock);
+    bool got = queue->head < queue->tail;
+    if(got) {
+        *task = steal ? queue->tasks[queue->head++]
+                      : queue->tasks[--queue->tail];
+        if(queue->head == queue->tail) {
+            queue->head = queue->tail = 0;
+        }
+        pthread_mutex_lock(&pool->lock);
+        pool->n_queued--;
+        pthread_mutex_unlock(&pool->lock);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return got;
+}
+
+static bool find_task(Pool *pool, int self, PoolTask *task) {
+    if(queue_take(pool, &pool->queues[self], false, task) ||
+       queue_take(pool, &pool->injected, true, task)) {
+        return true;
+    }
+    for(int i = 1; i < pool->n_workers; i++) {
+        int victim = (self + i) % pool->n_workers;
+        if(queue_take(pool, &pool->queues[victim], true, task)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void *pool_worker_run(void *arg) {
+    PoolWorker *worker = arg;
+    Pool *pool = worker->pool;
+    int self = worker->idx;
+    stil_free(worker);
+    current_pool = pool;
+    current_worker = self;
+
+    while(true) {
+        PoolTask task;
+        if(!find_task(pool, self, &task)) {
+            pthread_mutex_lock(&pool->lock);
+            while(pool->n_queued == 0 && !pool->stopping) {
+                pthread_cond_wait(&pool->has_work, &pool->lock);
+            }
+            bool stop = pool->n_queued == 0 && pool->stopping;
+            pthread_mutex_unlock(&pool->lock);
+            if(stop) {
+                return NULL;
+            }
+            continue;
+        }
+
+        task.fn(task.arg);
+
+        pthread_mutex_lock(&pool->lock);
+        if(--pool->n_unfinished == 0) {
+            pthread_cond_broadcast(&pool->all_done);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+Pool *pool_init(int n_workers) {
+    Pool *pool = stil_calloc(1, sizeof *pool);
+    pool->n_workers = n_workers > 0 ? n_workers : 1;
+    pool->queues = stil_calloc(pool->n_workers, sizeof(PoolQueue));
+    pool->threads = stil_malloc(pool->n_workers * sizeof(pthread_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->has_work, NULL);
+    pthread_cond_init(&pool->all_done, NULL);
+
+    pthread_mutex_init(&pool->injected.lock, NULL);
+    for(int i = 0; i < pool->n_workers; i++) {
+        pthread_mutex_init(&pool->queues[i].lock, NULL);
+    }
+    for(int i = 0; i < pool->n_workers; i++) {
+        PoolWorker *worker = stil_malloc(sizeof *worker);
+        *worker = (PoolWorker){.pool = pool, .idx = i};
+        if(pthread_create(&pool->threads[i], NULL, pool_worker_run, worker) !=
+           0) {
+            stil_fatal("Couldn't spawn pool thread");
+        }
+    }
+
+    return pool;
+}
+
+void pool_submit(Pool *pool, PoolTaskFn fn, void *arg) {
+    PoolTask task = {.fn = fn, .arg = arg};
+    queue_push(pool, current_pool == pool ? &pool->queues[current_worker]
+                                          : &pool->injected,
+               task);
+}
+
+void pool_wait(Pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while(pool->n_unfinished > 0) {
+        pthread_cond_wait(&pool->all_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_deinit(Pool *pool) {
+    pool_wait(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+    for(int i = 0; i < pool->n_workers; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    for(int i = 0; i < pool->n_workers; i++) {
+        pthread_mutex_destroy(&pool->queues[i].lock);
+        stil_free(pool->queues[i].tasks);
+    }
+    pthread_mutex_destroy(&pool->injected.lock);
+    stil_free(pool->injected.tasks);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->has_work);
+    pthread_cond_destroy(&pool->all_done);
+    stil_free(pool->queues);
+    stil_free(pool->threads);
+    stil_free(pool);
+}
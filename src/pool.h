@@ -0,0 +1,58 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Fixed set of worker threads running tasks off work stealing queues. Every
+ * worker has its own queue and takes the newest task off it first, and when
+ * it runs dry it steals the oldest task from someone else's. Tasks submitted
+ * from inside a task go on the submitting worker's own queue. Anything from
+ * outside the pool goes on a shared queue that workers take from in the
+ * order it was submitted, once their own queue is empty and before
+ * stealing.
+ *
+ * The thread that made the pool doesn't run tasks, it's free to do other
+ * things until it calls pool_wait.
+ */
+
+typedef void (*PoolTaskFn)(void *arg);
+
+typedef struct _PoolTask {
+    PoolTaskFn fn;
+    void *arg;
+} PoolTask;
+
+typedef struct _PoolQueue {
+    pthread_mutex_t lock;
+    // tasks[head..tail) are waiting, thieves take from head, the owner
+    // from tail
+    PoolTask *tasks;
+    size_t head, tail, cap;
+} PoolQueue;
+
+typedef struct _Pool {
+    int n_workers;
+    PoolQueue *queues;
+    PoolQueue injected; // outside submissions, only ever taken from head
+    pthread_t *threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t has_work;
+    pthread_cond_t all_done;
+    size_t n_queued;     // sitting in a queue
+    size_t n_unfinished; // queued or running
+    bool stopping;
+} Pool;
+
+Pool *pool_init(int n_workers);
+void pool_submit(Pool *pool, PoolTaskFn fn, void *arg);
+// blocks until every task submitted so far, and everything they submitted,
+// has finished
+void pool_wait(Pool *pool);
+// waits for the pool to go idle, then stops and frees it
+void pool_deinit(Pool *pool);
+
+#endif
@@ -0,0 +1,219 @@
+#include "reparse.h"
+#include "parser.h"
+#include <string.h>
+
+// compared a page at a time until they differ, then byte by byte
+#define COMPARE_STRIDE 4096
+
+static size_t common_prefix(const char *a, const char *b, size_t len) {
+    size_t n = 0;
+    while(n + COMPARE_STRIDE <= len &&
+          memcmp(a + n, b + n, COMPARE_STRIDE) == 0) {
+        n += COMPARE_STRIDE;
+    }
+    while(n < len && a[n] == b[n]) {
+        n++;
+    }
+    return n;
+}
+
+// a_end and b_end point just past the ends
+static size_t common_suffix(const char *a_end, const char *b_end, size_t len) {
+    size_t n = 0;
+    while(n + COMPARE_STRIDE <= len &&
+          memcmp(a_end - n - COMPARE_STRIDE, b_end - n - COMPARE_STRIDE,
+                 COMPARE_STRIDE) == 0) {
+        n += COMPARE_STRIDE;
+    }
+    while(n < len && a_end[-n - 1] == b_end[-n - 1]) {
+        n++;
+    }
+    return n;
+}
+
+// where an offset in the unchanged tail of old ends up in new
+static inline size_t shifted(size_t pos, size_t old_len, size_t new_len) {
+    return new_len - (old_len - pos);
+}
+
+static inline size_t shifted_start(STUnitList *units, size_t i,
+                                   size_t old_len, size_t new_len) {
+    return shifted(st_unit_list_at(units, i)->span_start, old_len, new_len);
+}
+
+static inline void move_symbol(Symbol *symbol, size_t from, size_t to) {
+    symbol->offset = symbol->offset - from + to;
+}
+
+static void move_expr(ASTNode *root, size_t from, size_t to,
+                      ASTNodeList *pending) {
+    pending->count = 0;
+    astnode_list_push(pending, root);
+    while(pending->count > 0) {
+        ASTNode *node = astnode_list_at(pending, --pending->count);
+        switch(node->kind) {
+            case ASTNODE_SYMBOL:
+                move_symbol(&node->symbol, from, to);
+                break;
+            case ASTNODE_BINARY_EXPR:
+                astnode_list_push(pending, node->binary_expr.rhs);
+                astnode_list_push(pending, node->binary_expr.lhs);
+                break;
+            case ASTNODE_UNARY_EXPR:
+                astnode_list_push(pending, node->unary_expr.operand);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Puts a kept unit where it now starts. Symbols are the only other things
+// in the tree that know where they are, and sema reports errors at them, so
+// they go along with it
+static void move_unit(STUnit *unit, size_t start, ASTNodeList *pending) {
+    size_t from = unit->span_start;
+    if(from == start) {
+        return;
+    }
+    unit->span_end = unit->span_end - from + start;
+    unit->span_start = start;
+    move_symbol(unit->name, from, start);
+
+    for(size_t i = 0; i < unit->variable_blocks->count; i++) {
+        ASTNodeList *decls =
+            astnode_list_at(unit->variable_blocks, i)->var_block.var_decls;
+        for(size_t j = 0; j < decls->count; j++) {
+            VarDeclaration *decl = &astnode_list_at(decls, j)->var_decl;
+            for(size_t k = 0; k < decl->labels->count; k++) {
+                move_symbol(symbol_list_at(decl->labels, k), from, start);
+            }
+            if(decl->type_name) {
+                move_symbol(decl->type_name, from, start);
+            }
+            if(decl->value) {
+                move_expr(decl->value, from, start, pending);
+            }
+        }
+    }
+    for(size_t i = 0; i < unit->statements->count; i++) {
+        ASTNode *stmt = astnode_list_at(unit->statements, i);
+        if(stmt->kind == ASTNODE_ASSIGNMENT_STMT) {
+            move_symbol(stmt->asgmt.name, from, start);
+            move_expr(stmt->asgmt.value, from, start, pending);
+        }
+    }
+}
+
+CompilationUnit *reparse_compilation_unit(CompilationUnit *comp_unit,
+                                          const Lexer *old, Lexer *new,
+                                          Arena *arena, int max_errors,
+                                          ReparseStats *stats) {
+    ReparseStats ignored;
+    if(!stats) {
+        stats = &ignored;
+    }
+    *stats = (ReparseStats){0};
+
+    STUnitList *units = comp_unit->st_units;
+    size_t n_units = units->count;
+    size_t old_len = old->source_len;
+    size_t new_len = new->source_len;
+    size_t shorter = old_len < new_len ? old_len : new_len;
+    size_t prefix = common_prefix(old->whole, new->whole, shorter);
+    if(prefix == old_len && old_len == new_len) {
+        stats->reused = n_units;
+        return comp_unit;
+    }
+    size_t suffix = common_suffix(old->whole + old_len, new->whole + new_len,
+                                  shorter - prefix);
+
+    // Units that end before the first change are kept. There has to be an
+    // untouched byte right after one, or its last token could have grown
+    size_t first = 0;
+    while(first < n_units &&
+          st_unit_list_at(units, first)->span_end < prefix) {
+        first++;
+    }
+    // and so are the ones in the untouched tail, if lexing the changed part
+    // lands right on their first token
+    size_t last = first;
+    while(last < n_units &&
+          st_unit_list_at(units, last)->span_start < old_len - suffix) {
+        last++;
+    }
+
+    size_t start = first > 0 ? st_unit_list_at(units, first - 1)->span_end : 0;
+    TokenBuffer *toks = token_buffer_init(64);
+    size_t from = start;
+    bool hit_eof;
+    while(true) {
+        size_t stop = last < n_units
+                          ? shifted_start(units, last, old_len, new_len)
+                          : new_len;
+        hit_eof = lexer_tokenize_until(new, from, stop, toks);
+        if(hit_eof) {
+            last = n_units;
+            break;
+        }
+        Token tok = token_at(toks, toks->count - 1);
+        if(tok.offset == stop) {
+            break;
+        }
+        // Something like an unclosed comment ran over where the unit starts,
+        // so it has to be parsed again too. That token is a fine place to
+        // pick the lexing back up from
+        while(last < n_units &&
+              shifted_start(units, last, old_len, new_len) < tok.offset) {
+            last++;
+        }
+        toks->count--;
+        from = tok.offset;
+    }
+    stats->relexed = token_at(toks, toks->count - 1).offset - start;
+
+    // the token the lexing stopped at starts a kept unit, so the parser
+    // gets to see it without going any further
+    Parser *parser = parser_init_span(new, toks, arena, 0,
+                                      hit_eof ? toks->count : toks->count - 1);
+    parser->max_errors = max_errors;
+    STUnitList *fresh = st_unit_list_init(arena);
+    parse_st_units(parser, fresh);
+    token_buffer_deinit(toks);
+
+    CompilationUnit *result = arena_alloc(arena, sizeof *result);
+    result->st_units = st_unit_list_init(arena);
+    ASTNodeList *pending = astnode_list_init(NULL);
+    for(size_t i = 0; i < first; i++) {
+        st_unit_list_push(result->st_units, st_unit_list_at(units, i));
+    }
+    for(size_t i = 0; i < fresh->count; i++) {
+        STUnit *unit = st_unit_list_at(fresh, i);
+        // one that reads exactly like its old self keeps the old subtree,
+        // so anything hanging on to it can tell nothing changed
+        STUnit *prev = first + i < last ? st_unit_list_at(units, first + i)
+                                        : NULL;
+        size_t len = unit->span_end - unit->span_start;
+        if(prev && prev->hash == unit->hash &&
+           prev->span_end - prev->span_start == len &&
+           memcmp(old->whole + prev->span_start,
+                  new->whole + unit->span_start, len) == 0) {
+            move_unit(prev, unit->span_start, pending);
+            unit = prev;
+            stats->reused++;
+        } else {
+            stats->reparsed++;
+        }
+        st_unit_list_push(result->st_units, unit);
+    }
+    for(size_t i = last; i < n_units; i++) {
+        STUnit *unit = st_unit_list_at(units, i);
+        move_unit(unit, shifted(unit->span_start, old_len, new_len),
+                  pending);
+        st_unit_list_push(result->st_units, unit);
+    }
+    stats->reused += first + (n_units - last);
+    astnode_list_deinit(pending);
+
+    return result;
+}
@@ -0,0 +1,32 @@
+#ifndef REPARSE_H
+#define REPARSE_H
+
+#include "ast.h"
+#include "lexer.h"
+
+typedef struct _ReparseStats {
+    size_t reused;   // units carried over from the old tree
+    size_t reparsed; // units that had to be parsed again
+    size_t relexed;  // bytes of the new source that got lexed
+} ReparseStats;
+
+/*
+ * Brings comp_unit, parsed from old's source without any errors, up to date
+ * with new's source by parsing only what changed. Units that sit wholly
+ * before or after the edited part of the file are reused as they are, with
+ * the spans and symbols of the ones after it shifted along, and everything
+ * in between is lexed and parsed again. So an edit costs about as much as
+ * the units it touches, plus a compare of the two sources.
+ *
+ * The result is the same tree a full parse of new would give. It shares
+ * nodes with comp_unit and the new ones go in arena, which has to be the
+ * one comp_unit lives in, so comp_unit shouldn't be used afterwards. Errors
+ * are reported through new like they'd be for a full parse, lexer warnings
+ * only for the part that got lexed again. stats can be NULL.
+ */
+CompilationUnit *reparse_compilation_unit(CompilationUnit *comp_unit,
+                                          const Lexer *old, Lexer *new,
+                                          Arena *arena, int max_errors,
+                                          ReparseStats *stats);
+
+#endif
@@ -0,0 +1,176 @@
+#include "resolve.h"
+#include "hashmap.h"
+#include "scope.h"
+#include <stdarg.h>
+#include <string.h>
+
+typedef struct _Resolver {
+    ScopeTable scopes;
+    HashMap units; // unit name -> STUnit, to catch the same name twice
+    Lexer *lexer;
+    int max_errors;
+} Resolver;
+
+static void resolve_error(Resolver *r, Symbol *symbol, const char *fmt, ...) {
+    Lexer *lexer = r->lexer;
+    if(r->max_errors > 0 && lexer->n_errors >= r->max_errors) {
+        return;
+    }
+
+    char msg[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(msg, sizeof msg, fmt, args);
+    va_end(args);
+    report(lexer, symbol->offset, intern_len(symbol->id), msg);
+
+    if(r->max_errors > 0 && lexer->n_errors >= r->max_errors) {
+        stil_warn_to(lexer->diag, "Stopping after %d errors",
+                     lexer->n_errors);
+    }
+}
+
+// IEC 61131-3 doesn't allow it, and the C backend counts on it to keep its
+// own names apart from ones made out of ST names
+static void check_underscores(Resolver *r, Symbol *symbol) {
+    // interning only changes the case, so the underscores are the same
+    if(strstr(intern_str(symbol->id), "__")) {
+        StrView name = symbol_spelling(r->lexer, symbol);
+        resolve_error(r, symbol, "'" SV_FMT "' has two underscores in a row",
+                      SV_ARG(name));
+    }
+}
+
+static void resolve_symbol(Resolver *r, Symbol *symbol) {
+    ScopeBinding *binding = scope_lookup(&r->scopes, symbol->id);
+    if(!binding) {
+        StrView name = symbol_spelling(r->lexer, symbol);
+        resolve_error(r, symbol, "Unknown name '" SV_FMT "'", SV_ARG(name));
+        return;
+    }
+    symbol->decl = binding->value;
+}
+
+// Expressions can nest far deeper than the C stack would like, so the
+// operands still to be looked at wait on a stack of our own
+static void resolve_expr(Resolver *r, ASTNode *root, ASTNodeList *pending) {
+    pending->count = 0;
+    astnode_list_push(pending, root);
+
+    while(pending->count > 0) {
+        ASTNode *node = astnode_list_at(pending, --pending->count);
+        switch(node->kind) {
+            case ASTNODE_SYMBOL:
+                resolve_symbol(r, &node->symbol);
+                break;
+            case ASTNODE_BINARY_EXPR:
+                astnode_list_push(pending, node->binary_expr.rhs);
+                astnode_list_push(pending, node->binary_expr.lhs);
+                break;
+            case ASTNODE_UNARY_EXPR:
+                astnode_list_push(pending, node->unary_expr.operand);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void declare_block(Resolver *r, VarBlock *block,
+                          ASTNodeList *pending) {
+    for(size_t i = 0; i < block->var_decls->count; i++) {
+        VarDeclaration *decl =
+            &astnode_list_at(block->var_decls, i)->var_decl;
+        // the initial value is looked up before the names it initializes
+        // come into scope
+        if(decl->value) {
+            resolve_expr(r, decl->value, pending);
+        }
+        for(size_t j = 0; j < decl->labels->count; j++) {
+            Symbol *label = symbol_list_at(decl->labels, j);
+            label->decl = decl;
+            check_underscores(r, label);
+            if(!scope_define(&r->scopes, label->id, decl)) {
+                StrView name = symbol_spelling(r->lexer, label);
+                resolve_error(r, label, "'" SV_FMT "' is already declared",
+                              SV_ARG(name));
+            }
+        }
+    }
+}
+
+static void declare_blocks(Resolver *r, STUnit *unit, bool globals,
+                           ASTNodeList *pending) {
+    for(size_t i = 0; i < unit->variable_blocks->count; i++) {
+        VarBlock *block =
+            &astnode_list_at(unit->variable_blocks, i)->var_block;
+        if((block->block_type == VARBLOCK_GLOBAL) == globals) {
+            declare_block(r, block, pending);
+        }
+    }
+}
+
+static void resolve_statements(Resolver *r, STUnit *unit,
+                               ASTNodeList *pending) {
+    for(size_t i = 0; i < unit->statements->count; i++) {
+        ASTNode *stmt = astnode_list_at(unit->statements, i);
+        switch(stmt->kind) {
+            case ASTNODE_ASSIGNMENT_STMT:
+                resolve_symbol(r, stmt->asgmt.name);
+                resolve_expr(r, stmt->asgmt.value, pending);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void check_unit_name(Resolver *r, STUnit *unit) {
+    check_underscores(r, unit->name);
+    uint64_t hash = hashmap_hash_u64(unit->name->id);
+    if(hashmap_get(&r->units, unit->name->id, hash)) {
+        StrView name = symbol_spelling(r->lexer, unit->name);
+        resolve_error(r, unit->name,
+                      "There's already a unit called '" SV_FMT "'",
+                      SV_ARG(name));
+        return;
+    }
+    hashmap_put(&r->units, unit->name->id, hash, unit);
+}
+
+void resolve_comp_unit(CompilationUnit *comp_unit, Lexer *lexer,
+                       int max_errors) {
+    Resolver r = {.lexer = lexer, .max_errors = max_errors};
+    STUnitList *units = comp_unit->st_units;
+    scope_table_init(&r.scopes);
+    hashmap_init(&r.units, units->count);
+    ASTNodeList *pending = astnode_list_init(NULL);
+
+    for(size_t i = 0; i < units->count; i++) {
+        declare_blocks(&r, st_unit_list_at(units, i), true, pending);
+    }
+
+    // an ACTION goes inside the scope of the PROGRAM before it, if any
+    size_t program_depth = 0;
+    for(size_t i = 0; i < units->count; i++) {
+        STUnit *unit = st_unit_list_at(units, i);
+        check_unit_name(&r, unit);
+
+        bool is_action = unit->unit_type == STUNIT_ACTION;
+        size_t outer = is_action ? program_depth : 0;
+        while(scope_depth(&r.scopes) > outer) {
+            scope_pop(&r.scopes);
+        }
+        scope_push(&r.scopes);
+        if(!is_action) {
+            program_depth = scope_depth(&r.scopes);
+        }
+
+        declare_blocks(&r, unit, false, pending);
+        resolve_statements(&r, unit, pending);
+    }
+
+    astnode_list_deinit(pending);
+    hashmap_deinit(&r.units);
+    scope_table_deinit(&r.scopes);
+}
@@ -0,0 +1,24 @@
+#ifndef RESOLVE_H
+#define RESOLVE_H
+
+#include "ast.h"
+#include "lexer.h"
+
+/*
+ * Points every Symbol that names a variable at its VarDeclaration and
+ * reports the names that don't refer to anything, along with variables and
+ * units declared twice and declared names with two underscores in a row.
+ * Scoping goes
+ *
+ *   VAR_GLOBAL from any unit       seen everywhere
+ *   a PROGRAM's other VAR blocks   seen in it and the ACTIONs after it,
+ *                                  up to the next PROGRAM
+ *   an ACTION's own VAR blocks     seen in that ACTION
+ *
+ * with inner declarations shadowing outer ones. Errors are reported through
+ * lexer, only the first max_errors of them in all if it's above 0.
+ */
+void resolve_comp_unit(CompilationUnit *comp_unit, Lexer *lexer,
+                       int max_errors);
+
+#endif
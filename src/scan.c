@@ -0,0 +1,168 @@
+#define _GNU_SOURCE
+#include "scan.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+static inline bool is_ws(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline bool is_ident(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_';
+}
+
+static const char *skip_ws_scalar(const char *p, const char *end) {
+    while(p < end && is_ws(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static const char *ident_end_scalar(const char *p, const char *end) {
+    while(p < end && is_ident(*p)) {
+        p++;
+    }
+    return p;
+}
+
+#ifdef SCAN_X86
+
+/*
+ * Bytes are compared as signed, which is fine since every class we care
+ * about is plain ASCII. Anything >= 0x80 comes out negative and so never
+ * lands inside a range.
+ */
+
+static inline __m128i in_range_sse2(__m128i v, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+}
+
+static inline __m128i ws_mask_sse2(__m128i v) {
+    return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                        in_range_sse2(v, '\t', '\r'));
+}
+
+static inline __m128i ident_mask_sse2(__m128i v) {
+    // folding to lowercase can't pull a non letter into a..z
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i alpha = in_range_sse2(lower, 'a', 'z');
+    __m128i digit = in_range_sse2(v, '0', '9');
+    __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    return _mm_or_si128(_mm_or_si128(alpha, digit), under);
+}
+
+static const char *skip_ws_sse2(const char *p, const char *end) {
+    while(end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(ws_mask_sse2(v));
+        if(mask != 0xFFFF) {
+            return p + __builtin_ctz(~mask);
+        }
+        p += 16;
+    }
+    return skip_ws_scalar(p, end);
+}
+
+static const char *ident_end_sse2(const char *p, const char *end) {
+    while(end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(ident_mask_sse2(v));
+        if(mask != 0xFFFF) {
+            return p + __builtin_ctz(~mask);
+        }
+        p += 16;
+    }
+    return ident_end_scalar(p, end);
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i in_range_avx2(__m256i v, char lo, char hi) {
+    return _mm256_and_si256(
+        _mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+}
+
+AVX2 static const char *skip_ws_avx2(const char *p, const char *end) {
+    while(end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+        __m256i ws = _mm256_or_si256(space, in_range_avx2(v, '\t', '\r'));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(ws);
+        if(mask != 0xFFFFFFFF) {
+            return p + __builtin_ctz(~mask);
+        }
+        p += 32;
+    }
+    return skip_ws_sse2(p, end);
+}
+
+AVX2 static const char *ident_end_avx2(const char *p, const char *end) {
+    while(end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i ident = _mm256_or_si256(
+            _mm256_or_si256(in_range_avx2(lower, 'a', 'z'),
+                            in_range_avx2(v, '0', '9')),
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(ident);
+        if(mask != 0xFFFFFFFF) {
+            return p + __builtin_ctz(~mask);
+        }
+        p += 32;
+    }
+    return ident_end_sse2(p, end);
+}
+
+#undef AVX2
+
+#endif
+
+typedef struct _ScanImpl {
+    const char *name;
+    const char *(*skip_ws)(const char *p, const char *end);
+    const char *(*ident_end)(const char *p, const char *end);
+} ScanImpl;
+
+#ifdef SCAN_X86
+static ScanImpl impl = {"sse2", skip_ws_sse2, ident_end_sse2};
+
+// picked before main runs so lexers on different threads never race on it
+__attribute__((constructor)) static void scan_select_impl() {
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        impl = (ScanImpl){"avx2", skip_ws_avx2, ident_end_avx2};
+    }
+}
+#else
+static ScanImpl impl = {"scalar", skip_ws_scalar, ident_end_scalar};
+#endif
+
+const char *scan_skip_ws(const char *p, const char *end) {
+    return impl.skip_ws(p, end);
+}
+
+const char *scan_ident_end(const char *p, const char *end) {
+    return impl.ident_end(p, end);
+}
+
+// libc's memchr already does its own vectorized search with cpu dispatch
+const char *scan_find_quote(const char *p, const char *end) {
+    const char *quote = memchr(p, '\'', end - p);
+    return quote ? quote : end;
+}
+
+const char *scan_find_comment_end(const char *p, const char *end) {
+    const char *close = memmem(p, end - p, "*)", 2);
+    return close ? close : end;
+}
+
+const char *scan_impl_name() { return impl.name; }
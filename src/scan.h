@@ -0,0 +1,26 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+/*
+ * Bulk character class scanners for the lexer's hot loops.
+ * Each one looks at [p, end) and returns a pointer to the first byte
+ * that doesn't belong to the run, or end if the whole range does.
+ *
+ * On x86_64 these classify 16 (SSE2) or 32 (AVX2) bytes at a time.
+ * AVX2 is picked at startup only if the cpu has it, everything else
+ * falls back to the plain byte loop.
+ */
+
+// ' ', \t, \n, \v, \f, \r
+const char *scan_skip_ws(const char *p, const char *end);
+// [A-Za-z0-9_]
+const char *scan_ident_end(const char *p, const char *end);
+// first ' that closes a string literal
+const char *scan_find_quote(const char *p, const char *end);
+// the * of the first *) that closes a block comment
+const char *scan_find_comment_end(const char *p, const char *end);
+
+// name of the implementation chosen at startup
+const char *scan_impl_name();
+
+#endif
@@ -0,0 +1,70 @@
+#include "scope.h"
+
+// bindings are small and get handed back all the time, this is only ever
+// address space
+#define SCOPE_ARENA_SIZE ((size_t)256 * 1024 * 1024)
+
+void scope_table_init(ScopeTable *table) {
+    hashmap_init(&table->names, 64);
+    table->arena = arena_init(SCOPE_ARENA_SIZE);
+    table->defined = intern_id_list_init(NULL);
+    table->marks = scope_mark_list_init(NULL);
+}
+
+void scope_table_deinit(ScopeTable *table) {
+    hashmap_deinit(&table->names);
+    arena_deinit(&table->arena);
+    intern_id_list_deinit(table->defined);
+    scope_mark_list_deinit(table->marks);
+}
+
+void scope_push(ScopeTable *table) {
+    scope_mark_list_push(table->marks, (ScopeMark){
+                                           .n_defined = table->defined->count,
+                                           .arena_offset = table->arena.offset,
+                                       });
+}
+
+void scope_pop(ScopeTable *table) {
+    if(table->marks->count == 0) {
+        stil_fatal("Popped the outermost scope");
+    }
+    ScopeMark mark = scope_mark_list_at(table->marks, --table->marks->count);
+
+    InternId *defined = intern_id_list_items(table->defined);
+    for(size_t i = table->defined->count; i > mark.n_defined; i--) {
+        InternId id = defined[i - 1];
+        uint64_t hash = hashmap_hash_u64(id);
+        ScopeBinding *binding = hashmap_get(&table->names, id, hash);
+        if(binding->shadowed) {
+            hashmap_put(&table->names, id, hash, binding->shadowed);
+        } else {
+            hashmap_remove(&table->names, id, hash);
+        }
+    }
+    table->defined->count = mark.n_defined;
+    arena_rewind(&table->arena, mark.arena_offset);
+}
+
+bool scope_define(ScopeTable *table, InternId id, void *value) {
+    uint64_t hash = hashmap_hash_u64(id);
+    ScopeBinding *outer = hashmap_get(&table->names, id, hash);
+    size_t depth = scope_depth(table);
+    if(outer && outer->depth == depth) {
+        return false;
+    }
+
+    ScopeBinding *binding = arena_alloc(&table->arena, sizeof *binding);
+    *binding = (ScopeBinding){
+        .value = value,
+        .depth = depth,
+        .shadowed = outer,
+    };
+    hashmap_put(&table->names, id, hash, binding);
+    intern_id_list_push(table->defined, id);
+    return true;
+}
+
+ScopeBinding *scope_lookup(const ScopeTable *table, InternId id) {
+    return hashmap_get(&table->names, id, hashmap_hash_u64(id));
+}
@@ -0,0 +1,57 @@
+#ifndef SCOPE_H
+#define SCOPE_H
+
+#include "arena.h"
+#include "hashmap.h"
+#include "intern.h"
+#include "vec.h"
+#include <stdbool.h>
+
+/*
+ * Nested scopes of names, e.g. globals, then a POU, then a method or block
+ * inside it. There's a single map from each name to its innermost binding,
+ * and a binding remembers the one it shadows. A scope is just the stretch
+ * of the log of defined names since it was pushed, so popping it puts back
+ * what those names shadowed and costs only as much as the scope had in it.
+ * Lookups are one map probe however deep the nesting goes.
+ *
+ * The outermost scope is there from the start and can't be popped.
+ */
+
+typedef struct _ScopeBinding {
+    void *value;
+    size_t depth;
+    struct _ScopeBinding *shadowed;
+} ScopeBinding;
+
+// where a scope starts in the log and the arena
+typedef struct _ScopeMark {
+    size_t n_defined;
+    size_t arena_offset;
+} ScopeMark;
+
+VEC_DEFINE(InternIdList, intern_id_list, InternId)
+VEC_DEFINE(ScopeMarkList, scope_mark_list, ScopeMark)
+
+typedef struct _ScopeTable {
+    HashMap names;         // InternId -> innermost ScopeBinding
+    Arena arena;           // bindings, given back as scopes are popped
+    InternIdList *defined; // every name bound in a scope that's still open
+    ScopeMarkList *marks;  // one per scope pushed
+} ScopeTable;
+
+void scope_table_init(ScopeTable *table);
+void scope_table_deinit(ScopeTable *table);
+void scope_push(ScopeTable *table);
+void scope_pop(ScopeTable *table);
+// 0 in the outermost scope
+static inline size_t scope_depth(const ScopeTable *table) {
+    return table->marks->count;
+}
+// Binds id in the innermost scope. Fails, leaving things as they were, if
+// it's already bound there
+bool scope_define(ScopeTable *table, InternId id, void *value);
+// the innermost binding of id, NULL if it isn't bound at all
+ScopeBinding *scope_lookup(const ScopeTable *table, InternId id);
+
+#endif
@@ -0,0 +1,320 @@
+#include "sema.h"
+#include "hashmap.h"
+#include "resolve.h"
+#include <stdarg.h>
+
+typedef struct _Sema {
+    TypeList *types;
+    HashMap distinct; // a Type's kind and name -> its TypeId
+    HashMap named;    // type name -> TypeId
+    TypeId builtin[NO_TYPE]; // the TypeId for each TypeDecl keyword
+    Lexer *lexer;
+    int max_errors;
+} Sema;
+
+// an expression along with whether its operands have been typed already
+typedef struct _ExprFrame {
+    ASTNode *node;
+    bool operands_done;
+} ExprFrame;
+
+VEC_DEFINE(ExprFrameList, expr_frame_list, ExprFrame)
+
+static void sema_error(Sema *sema, Symbol *at, const char *fmt, ...) {
+    Lexer *lexer = sema->lexer;
+    if(sema->max_errors > 0 && lexer->n_errors >= sema->max_errors) {
+        return;
+    }
+
+    char msg[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(msg, sizeof msg, fmt, args);
+    va_end(args);
+    report(lexer, at->offset, intern_len(at->id), msg);
+
+    if(sema->max_errors > 0 && lexer->n_errors >= sema->max_errors) {
+        stil_warn_to(lexer->diag, "Stopping after %d errors",
+                     lexer->n_errors);
+    }
+}
+
+static TypeId add_type(Sema *sema, Type type) {
+    uint64_t key = (uint64_t)type.kind << 32 | type.name;
+    uint64_t hash = hashmap_hash_u64(key);
+    uintptr_t found = (uintptr_t)hashmap_get(&sema->distinct, key, hash);
+    if(found) {
+        return found - 1;
+    }
+
+    TypeId id = sema->types->count;
+    type_list_push(sema->types, type);
+    // +1 so that id 0 isn't mistaken for a miss
+    hashmap_put(&sema->distinct, key, hash, (void *)(uintptr_t)(id + 1));
+    if(type.name != INTERN_NONE) {
+        hashmap_put(&sema->named, type.name, hashmap_hash_u64(type.name),
+                    (void *)(uintptr_t)(id + 1));
+    }
+    return id;
+}
+
+static void add_builtin(Sema *sema, TypeDecl kind) {
+    const char *name = type_dbg(kind);
+    sema->builtin[kind] = add_type(sema, (Type){
+                                             .kind = kind,
+                                             .name = intern(name, strlen(name)),
+                                         });
+}
+
+static inline TypeDecl kind_of(Sema *sema, TypeId id) {
+    return type_list_items(sema->types)[id].kind;
+}
+
+static inline const char *type_name(Sema *sema, TypeId id) {
+    return intern_str(type_list_items(sema->types)[id].name);
+}
+
+static inline bool is_numeric(Sema *sema, TypeId id) {
+    TypeDecl kind = kind_of(sema, id);
+    return kind == TYPE_INT || kind == TYPE_REAL;
+}
+
+// the type both a and b can be taken as, TYPE_ID_NONE if there's none
+static TypeId common_type(Sema *sema, TypeId a, TypeId b) {
+    if(a == b) {
+        return a;
+    }
+    if(is_numeric(sema, a) && is_numeric(sema, b)) {
+        return sema->builtin[TYPE_REAL];
+    }
+    return TYPE_ID_NONE;
+}
+
+static bool fits(Sema *sema, TypeId to, TypeId from) {
+    if(to == TYPE_ID_NONE || from == TYPE_ID_NONE || to == from) {
+        return true;
+    }
+    return kind_of(sema, to) == TYPE_REAL && kind_of(sema, from) == TYPE_INT;
+}
+
+static TypeId binary_type(Sema *sema, BinaryExpr *expr, Symbol *at) {
+    TypeId lhs = expr->lhs->type_id;
+    TypeId rhs = expr->rhs->type_id;
+    if(lhs == TYPE_ID_NONE || rhs == TYPE_ID_NONE) {
+        return TYPE_ID_NONE;
+    }
+
+    TypeId common = common_type(sema, lhs, rhs);
+    TypeId result = TYPE_ID_NONE;
+    switch(expr->op) {
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_POW:
+            if(common != TYPE_ID_NONE && is_numeric(sema, common)) {
+                result = common;
+            }
+            break;
+        case OP_MOD:
+            if(common != TYPE_ID_NONE && kind_of(sema, common) == TYPE_INT) {
+                result = common;
+            }
+            break;
+        case OP_LT:
+        case OP_LTE:
+        case OP_GT:
+        case OP_GTE:
+        case OP_EQ:
+        case OP_NE:
+            if(common != TYPE_ID_NONE) {
+                result = sema->builtin[TYPE_BOOL];
+            }
+            break;
+        case OP_AND:
+        case OP_OR:
+        case OP_XOR:
+            if(common != TYPE_ID_NONE && kind_of(sema, common) == TYPE_BOOL) {
+                result = common;
+            }
+            break;
+        case NO_INFIX:
+            break;
+    }
+
+    if(result == TYPE_ID_NONE) {
+        sema_error(sema, at, "Can't apply '%s' to %s and %s",
+                   infix_op_dbg(expr->op), type_name(sema, lhs),
+                   type_name(sema, rhs));
+    }
+    return result;
+}
+
+static TypeId unary_type(Sema *sema, UnaryExpr *expr, Symbol *at) {
+    TypeId operand = expr->operand->type_id;
+    if(operand == TYPE_ID_NONE) {
+        return TYPE_ID_NONE;
+    }
+
+    bool ok = expr->op == OP_NEG   ? is_numeric(sema, operand)
+              : expr->op == OP_NOT ? kind_of(sema, operand) == TYPE_BOOL
+                                   : false;
+    if(!ok) {
+        sema_error(sema, at, "Can't apply '%s' to %s",
+                   prefix_op_dbg(expr->op), type_name(sema, operand));
+        return TYPE_ID_NONE;
+    }
+    return operand;
+}
+
+// Types root and everything under it. Expression nodes don't know where
+// they are in the source, so errors inside one point at the name the
+// statement or declaration it's part of is about
+static TypeId type_expr(Sema *sema, ASTNode *root, Symbol *at,
+                        ExprFrameList *pending) {
+    pending->count = 0;
+    expr_frame_list_push(pending, (ExprFrame){.node = root});
+
+    while(pending->count > 0) {
+        ExprFrame frame = expr_frame_list_at(pending, --pending->count);
+        ASTNode *node = frame.node;
+        switch(node->kind) {
+            case ASTNODE_INT_LITERAL:
+                node->type_id = sema->builtin[TYPE_INT];
+                break;
+            case ASTNODE_REAL_LITERAL:
+                node->type_id = sema->builtin[TYPE_REAL];
+                break;
+            case ASTNODE_STR_LITERAL:
+                node->type_id = sema->builtin[TYPE_STRING];
+                break;
+            case ASTNODE_BOOL_LITERAL:
+                node->type_id = sema->builtin[TYPE_BOOL];
+                break;
+            case ASTNODE_SYMBOL:
+                node->type_id =
+                    node->symbol.decl ? node->symbol.decl->type_id
+                                      : TYPE_ID_NONE;
+                break;
+            case ASTNODE_BINARY_EXPR:
+                if(frame.operands_done) {
+                    node->type_id = binary_type(sema, &node->binary_expr, at);
+                    break;
+                }
+                expr_frame_list_push(pending, (ExprFrame){node, true});
+                expr_frame_list_push(pending,
+                                     (ExprFrame){node->binary_expr.rhs, false});
+                expr_frame_list_push(pending,
+                                     (ExprFrame){node->binary_expr.lhs, false});
+                break;
+            case ASTNODE_UNARY_EXPR:
+                if(frame.operands_done) {
+                    node->type_id = unary_type(sema, &node->unary_expr, at);
+                    break;
+                }
+                expr_frame_list_push(pending, (ExprFrame){node, true});
+                expr_frame_list_push(pending,
+                                     (ExprFrame){node->unary_expr.operand,
+                                                 false});
+                break;
+            default:
+                node->type_id = TYPE_ID_NONE;
+                break;
+        }
+    }
+    return root->type_id;
+}
+
+static void check_fits(Sema *sema, TypeId to, ASTNode *value, Symbol *at,
+                       ExprFrameList *pending) {
+    TypeId from = type_expr(sema, value, at, pending);
+    if(!fits(sema, to, from)) {
+        StrView name = symbol_spelling(sema->lexer, at);
+        sema_error(sema, at, "Can't store %s in '" SV_FMT "', it's %s",
+                   type_name(sema, from), SV_ARG(name), type_name(sema, to));
+    }
+}
+
+// declarations get their types before anything else is looked at, since a
+// global can be used before the unit that declares it
+static void type_declarations(Sema *sema, STUnit *unit) {
+    for(size_t i = 0; i < unit->variable_blocks->count; i++) {
+        ASTNodeList *decls =
+            astnode_list_at(unit->variable_blocks, i)->var_block.var_decls;
+        for(size_t j = 0; j < decls->count; j++) {
+            VarDeclaration *decl = &astnode_list_at(decls, j)->var_decl;
+            if(decl->type < NO_RETURN_TYPE) {
+                decl->type_id = sema->builtin[decl->type];
+                continue;
+            }
+
+            Symbol *name = decl->type_name;
+            uintptr_t found = (uintptr_t)hashmap_get(
+                &sema->named, name->id, hashmap_hash_u64(name->id));
+            decl->type_id = found ? found - 1 : TYPE_ID_NONE;
+            if(!found) {
+                StrView type = symbol_spelling(sema->lexer, name);
+                sema_error(sema, name, "Unknown type '" SV_FMT "'",
+                           SV_ARG(type));
+            }
+        }
+    }
+}
+
+static void check_unit(Sema *sema, STUnit *unit, ExprFrameList *pending) {
+    for(size_t i = 0; i < unit->variable_blocks->count; i++) {
+        ASTNodeList *decls =
+            astnode_list_at(unit->variable_blocks, i)->var_block.var_decls;
+        for(size_t j = 0; j < decls->count; j++) {
+            VarDeclaration *decl = &astnode_list_at(decls, j)->var_decl;
+            if(decl->value) {
+                check_fits(sema, decl->type_id, decl->value,
+                           symbol_list_at(decl->labels, 0), pending);
+            }
+        }
+    }
+
+    for(size_t i = 0; i < unit->statements->count; i++) {
+        ASTNode *stmt = astnode_list_at(unit->statements, i);
+        switch(stmt->kind) {
+            case ASTNODE_ASSIGNMENT_STMT: {
+                Symbol *name = stmt->asgmt.name;
+                TypeId to = name->decl ? name->decl->type_id : TYPE_ID_NONE;
+                check_fits(sema, to, stmt->asgmt.value, name, pending);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+void sema_comp_unit(CompilationUnit *comp_unit, Lexer *lexer, Arena *arena,
+                    int max_errors) {
+    resolve_comp_unit(comp_unit, lexer, max_errors);
+
+    Sema sema = {.lexer = lexer, .max_errors = max_errors};
+    sema.types = type_list_init(arena);
+    hashmap_init(&sema.distinct, 16);
+    hashmap_init(&sema.named, 16);
+    // TYPE_ID_NONE
+    add_type(&sema, (Type){.kind = NO_TYPE, .name = INTERN_NONE});
+    add_builtin(&sema, TYPE_INT);
+    add_builtin(&sema, TYPE_REAL);
+    add_builtin(&sema, TYPE_STRING);
+    add_builtin(&sema, TYPE_BOOL);
+
+    STUnitList *units = comp_unit->st_units;
+    for(size_t i = 0; i < units->count; i++) {
+        type_declarations(&sema, st_unit_list_at(units, i));
+    }
+    ExprFrameList *pending = expr_frame_list_init(NULL);
+    for(size_t i = 0; i < units->count; i++) {
+        check_unit(&sema, st_unit_list_at(units, i), pending);
+    }
+
+    expr_frame_list_deinit(pending);
+    hashmap_deinit(&sema.named);
+    hashmap_deinit(&sema.distinct);
+    comp_unit->types = sema.types;
+}
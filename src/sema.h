@@ -0,0 +1,29 @@
+#ifndef SEMA_H
+#define SEMA_H
+
+#include "arena.h"
+#include "ast.h"
+#include "lexer.h"
+
+/*
+ * Everything that has to hold for a tree that parsed before it's worth
+ * generating anything from it. Names are resolved first (see resolve.h),
+ * then every declared type goes into comp_unit->types, which is kept in
+ * arena, and every declaration and expression gets its TypeId. Initial
+ * values and assignments have to fit what they're stored in, where an INT
+ * fits a REAL but nothing else converts on its own.
+ *
+ * Each expression is typed once, from its operands up, so it's all a single
+ * walk over the tree. Anything that's already wrong types as TYPE_ID_NONE
+ * and quietly fits everywhere, so one mistake is reported once. Errors go
+ * through lexer, only the first max_errors of them in all if it's above 0.
+ */
+void sema_comp_unit(CompilationUnit *comp_unit, Lexer *lexer, Arena *arena,
+                    int max_errors);
+
+static inline const Type *type_of(const CompilationUnit *comp_unit,
+                                  TypeId id) {
+    return &type_list_items(comp_unit->types)[id];
+}
+
+#endif
@@ -1,6 +1,14 @@
 #include "shared.h"
 #include <stdarg.h>
 
+// bumped from whichever thread allocates, only ever read for stats
+static size_t n_allocs = 0;
+#define COUNT_ALLOC() __atomic_fetch_add(&n_allocs, 1, __ATOMIC_RELAXED)
+
+size_t stil_alloc_count() {
+    return __atomic_load_n(&n_allocs, __ATOMIC_RELAXED);
+}
+
 void *p_stil_malloc(size_t size, const char *file, int line) {
     if(size == 0) {
         return NULL;
@@ -10,6 +18,7 @@ void *p_stil_malloc(size_t size, const char *file, int line) {
     if(!mem) {
         stil_fatal("Couldn't malloc in %s at line %d", file, line);
     }
+    COUNT_ALLOC();
 
     return mem;
 }
@@ -23,6 +32,7 @@ void *p_stil_calloc(size_t nmemb, size_t size, const char *file, int line) {
     if(!mem) {
         stil_fatal("Couldn't calloc in %s at line %d", file, line);
     }
+    COUNT_ALLOC();
 
     return mem;
 }
@@ -41,6 +51,7 @@ void *p_stil_realloc(void *mem, size_t size, const char *file, int line) {
     if(!new_mem) {
         stil_fatal("Couldn't realloc in %s at line %d", file, line);
     }
+    COUNT_ALLOC();
 
     return new_mem;
 }
@@ -77,17 +88,29 @@ static const LogStyle LOG_LEVEL_TO_STYLE[] = {
     },
 };
 
-void p_stil_log(LogLevel level, const char *fmt, ...) {
+static void stil_vlog(FILE *out, LogLevel level, const char *fmt,
+                      va_list args) {
     const LogStyle *style = &(LOG_LEVEL_TO_STYLE[level]);
-    printf("%s%s%s ", style->label_style, style->label, ANSI_RESET);
-    printf("%s", style->msg_style);
-    va_list args;
-    va_start(args, fmt);
-    vprintf(fmt, args);
-    va_end(args);
-    printf("%s\n", ANSI_RESET);
+    fprintf(out, "%s%s%s ", style->label_style, style->label, ANSI_RESET);
+    fprintf(out, "%s", style->msg_style);
+    vfprintf(out, fmt, args);
+    fprintf(out, "%s\n", ANSI_RESET);
 
     if(level == LOG_FATAL) {
         exit(1);
     }
 }
+
+void p_stil_log(LogLevel level, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    stil_vlog(stdout, level, fmt, args);
+    va_end(args);
+}
+
+void p_stil_log_to(FILE *out, LogLevel level, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    stil_vlog(out, level, fmt, args);
+    va_end(args);
+}
@@ -1,8 +1,47 @@
 #ifndef SHARED_H
 #define SHARED_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+// anything built from the output of one version is stale for the next
+#define STIL_VERSION "0.1.0"
+
+/* string views */
+typedef struct _StrView {
+    const char *ptr;
+    size_t len;
+} StrView;
+
+#define SV_FMT     "%.*s"
+#define SV_ARG(sv) (int)(sv).len, (sv).ptr
+
+/* hashing */
+// Content hash for telling whether bytes changed, 8 of them at a time.
+// Not for hash tables keyed by short strings, see intern.c for that
+static inline uint64_t stil_hash(const void *data, size_t len, uint64_t seed) {
+    const unsigned char *p = data;
+    uint64_t hash = seed ^ (len * 0x9e3779b97f4a7c15);
+    for(; len >= 8; p += 8, len -= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15;
+        hash ^= hash >> 32;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p, len);
+    hash = (hash ^ tail) * 0x9e3779b97f4a7c15;
+    // murmur3's finalizer, so every input bit can reach every output bit
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccd;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53;
+    hash ^= hash >> 33;
+    return hash;
+}
 
 /* alloc */
 void *p_stil_malloc(size_t size, const char *file, int line);
@@ -16,14 +55,21 @@ void *p_stil_realloc(void *mem, size_t size, const char *file, int line);
 
 void stil_free(void *mem);
 
+// number of successful stil_malloc/calloc/realloc calls so far
+size_t stil_alloc_count();
+
 /* log */
 typedef enum _LogLevel { LOG_INFO = 0, LOG_WARN, LOG_FATAL } LogLevel;
 void p_stil_log(LogLevel level, const char *fmt, ...);
+// for messages that belong with a file's diagnostics, see Lexer.diag
+void p_stil_log_to(FILE *out, LogLevel level, const char *fmt, ...);
 
 #define stil_info(...)  p_stil_log(LOG_INFO, __VA_ARGS__)
 #define stil_warn(...)  p_stil_log(LOG_WARN, __VA_ARGS__)
 #define stil_fatal(...) p_stil_log(LOG_FATAL, __VA_ARGS__)
 
+#define stil_warn_to(out, ...) p_stil_log_to(out, LOG_WARN, __VA_ARGS__)
+
 #define ANSI_ESC(code) "\x1b[" code "m"
 
 #define ANSI_RESET ANSI_ESC("0")
@@ -0,0 +1,86 @@
+#ifndef VEC_H
+#define VEC_H
+
+#include "arena.h"
+#include "shared.h"
+#include <string.h>
+
+/*
+ * Typed growable arrays.
+ *
+ *   VEC_DEFINE(ASTNodeList, astnode_list, ASTNode *)
+ *
+ * declares the ASTNodeList type along with astnode_list_init, _push, _at,
+ * _items and _deinit. The first VEC_INLINE_CAP items live inside the vector
+ * itself, which covers most lists in a tree without any further allocation.
+ * Past that the capacity doubles each time it runs out.
+ *
+ * A vector made with an arena takes all its memory from that arena and is
+ * released with it, _deinit is a no op for it. Without one it uses the heap.
+ * There are no pointers into the vector itself, so it can be copied around
+ * freely, but _items is only good until the next push.
+ */
+
+#define VEC_INLINE_CAP 4
+
+#define VEC_DEFINE(Name, prefix, T)                                            \
+    typedef struct _##Name {                                                   \
+        size_t count, cap;                                                     \
+        Arena *arena;                                                          \
+        union {                                                                \
+            T *heap;                                                           \
+            T small[VEC_INLINE_CAP];                                           \
+        };                                                                     \
+    } Name;                                                                    \
+                                                                               \
+    static inline Name *prefix##_init(Arena *arena) {                          \
+        Name *vec = arena ? arena_alloc(arena, sizeof *vec)                    \
+                          : stil_calloc(1, sizeof *vec);                       \
+        vec->cap = VEC_INLINE_CAP;                                             \
+        vec->arena = arena;                                                    \
+        return vec;                                                            \
+    }                                                                          \
+                                                                               \
+    static inline T *prefix##_items(Name *vec) {                               \
+        return vec->cap > VEC_INLINE_CAP ? vec->heap : vec->small;             \
+    }                                                                          \
+                                                                               \
+    static inline T prefix##_at(const Name *vec, size_t idx) {                 \
+        return vec->cap > VEC_INLINE_CAP ? vec->heap[idx] : vec->small[idx];   \
+    }                                                                          \
+                                                                               \
+    static inline void prefix##_grow(Name *vec) {                              \
+        size_t new_cap = vec->cap * 2;                                         \
+        T *items;                                                              \
+        if(vec->cap == VEC_INLINE_CAP) {                                       \
+            items = vec->arena ? arena_alloc(vec->arena, new_cap * sizeof(T))  \
+                               : stil_malloc(new_cap * sizeof(T));             \
+            memcpy(items, vec->small, sizeof vec->small);                      \
+        } else if(vec->arena) {                                                \
+            items = arena_realloc(vec->arena, vec->heap, vec->cap * sizeof(T), \
+                                  new_cap * sizeof(T));                        \
+        } else {                                                               \
+            items = stil_realloc(vec->heap, new_cap * sizeof(T));              \
+        }                                                                      \
+        vec->heap = items;                                                     \
+        vec->cap = new_cap;                                                    \
+    }                                                                          \
+                                                                               \
+    static inline void prefix##_push(Name *vec, T item) {                      \
+        if(vec->count == vec->cap) {                                           \
+            prefix##_grow(vec);                                                \
+        }                                                                      \
+        prefix##_items(vec)[vec->count++] = item;                              \
+    }                                                                          \
+                                                                               \
+    static inline void prefix##_deinit(Name *vec) {                            \
+        if(vec->arena) {                                                       \
+            return;                                                            \
+        }                                                                      \
+        if(vec->cap > VEC_INLINE_CAP) {                                        \
+            stil_free(vec->heap);                                              \
+        }                                                                      \
+        stil_free(vec);                                                        \
+    }
+
+#endif
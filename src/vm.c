@@ -0,0 +1,489 @@
+#include "vm.h"
+#include <math.h>
+#include <string.h>
+
+// Every instruction, in the order their handlers are listed in run()
+#define VM_OPS(X)                                                              \
+    X(MOV)                                                                     \
+    X(ITOF)                                                                    \
+    X(NEG_INT)                                                                 \
+    X(NEG_REAL)                                                                \
+    X(NOT)                                                                     \
+    X(ADD_INT)                                                                 \
+    X(ADD_REAL)                                                                \
+    X(SUB_INT)                                                                 \
+    X(SUB_REAL)                                                                \
+    X(MUL_INT)                                                                 \
+    X(MUL_REAL)                                                                \
+    X(DIV_INT)                                                                 \
+    X(DIV_REAL)                                                                \
+    X(MOD_INT)                                                                 \
+    X(POW_INT)                                                                 \
+    X(POW_REAL)                                                                \
+    X(LT_INT)                                                                  \
+    X(LT_REAL)                                                                 \
+    X(LT_STR)                                                                  \
+    X(LTE_INT)                                                                 \
+    X(LTE_REAL)                                                                \
+    X(LTE_STR)                                                                 \
+    X(GT_INT)                                                                  \
+    X(GT_REAL)                                                                 \
+    X(GT_STR)                                                                  \
+    X(GTE_INT)                                                                 \
+    X(GTE_REAL)                                                                \
+    X(GTE_STR)                                                                 \
+    X(EQ_INT)                                                                  \
+    X(EQ_REAL)                                                                 \
+    X(EQ_STR)                                                                  \
+    X(NE_INT)                                                                  \
+    X(NE_REAL)                                                                 \
+    X(NE_STR)                                                                  \
+    X(AND)                                                                     \
+    X(OR)                                                                      \
+    X(XOR)                                                                     \
+    X(RET)
+
+typedef enum _VMOp {
+#define X(name) VM_##name,
+    VM_OPS(X)
+#undef X
+} VMOp;
+
+// where the frame is split up, see vm.h
+typedef struct _Layout {
+    uint32_t regs;       // first IR register
+    uint32_t next_const; // next free constant slot
+    uint32_t *loc;       // IR register -> frame slot holding its value
+    uint32_t *uses;      // IR register -> number of times it's read
+} Layout;
+
+static inline TypeDecl kind_of(const IRModule *module, TypeId id) {
+    return type_list_at(module->types, id).kind;
+}
+
+// picks the INT, REAL or STR flavour of an instruction
+static uint32_t by_kind(TypeDecl kind, VMOp int_op) {
+    switch(kind) {
+        case TYPE_REAL:
+            return int_op + 1;
+        case TYPE_STRING:
+            return int_op + 2;
+        default:
+            return int_op;
+    }
+}
+
+static uint32_t select_op(const IRModule *module, const IRInst *inst) {
+    TypeDecl kind = kind_of(module, inst->type);
+    switch(inst->op) {
+        case IR_ITOF:
+            return VM_ITOF;
+        case IR_NEG:
+            return kind == TYPE_REAL ? VM_NEG_REAL : VM_NEG_INT;
+        case IR_NOT:
+            return VM_NOT;
+        case IR_ADD:
+            return by_kind(kind, VM_ADD_INT);
+        case IR_SUB:
+            return by_kind(kind, VM_SUB_INT);
+        case IR_MUL:
+            return by_kind(kind, VM_MUL_INT);
+        case IR_DIV:
+            return by_kind(kind, VM_DIV_INT);
+        case IR_MOD:
+            return VM_MOD_INT;
+        case IR_POW:
+            return by_kind(kind, VM_POW_INT);
+        case IR_LT:
+            return by_kind(kind, VM_LT_INT);
+        case IR_LTE:
+            return by_kind(kind, VM_LTE_INT);
+        case IR_GT:
+            return by_kind(kind, VM_GT_INT);
+        case IR_GTE:
+            return by_kind(kind, VM_GTE_INT);
+        case IR_EQ:
+            return by_kind(kind, VM_EQ_INT);
+        case IR_NE:
+            return by_kind(kind, VM_NE_INT);
+        case IR_AND:
+            return VM_AND;
+        case IR_OR:
+            return VM_OR;
+        case IR_XOR:
+            return VM_XOR;
+        default:
+            break;
+    }
+    stil_fatal("No VM instruction for %s", ir_op_name(inst->op));
+    return VM_RET;
+}
+
+static VMValue const_value(const IRModule *module, const IRInst *inst) {
+    VMValue value = {0};
+    switch(kind_of(module, inst->type)) {
+        case TYPE_REAL:
+            value.r = inst->real_val;
+            break;
+        case TYPE_STRING:
+            value.s = inst->str_val;
+            break;
+        case TYPE_BOOL:
+            value.i = inst->bool_val;
+            break;
+        default:
+            value.i = inst->int_val;
+            break;
+    }
+    return value;
+}
+
+static void compile_function(StilVM *vm, IRFunction *func, VMCode *code,
+                             Layout *layout) {
+    IRInst *insts = ir_inst_list_items(func->insts);
+    size_t n_insts = func->insts->count;
+    uint32_t *loc = layout->loc;
+    uint32_t *uses = layout->uses;
+
+    memset(uses, 0, func->n_vregs * sizeof *uses);
+    for(size_t i = 0; i < n_insts; i++) {
+        switch(insts[i].op) {
+            case IR_CONST:
+            case IR_LOAD:
+            case IR_RET:
+                break;
+            case IR_STORE:
+                uses[insts[i].b]++;
+                break;
+            case IR_ITOF:
+            case IR_NEG:
+            case IR_NOT:
+                uses[insts[i].a]++;
+                break;
+            default:
+                uses[insts[i].a]++;
+                uses[insts[i].b]++;
+                break;
+        }
+    }
+
+    code->insts = stil_malloc(n_insts * sizeof *code->insts);
+    code->count = 0;
+    // the register the last instruction wrote, if it's still in one
+    uint32_t last_def = UINT32_MAX;
+    for(size_t i = 0; i < n_insts; i++) {
+        IRInst *inst = &insts[i];
+        VMInst *out = &code->insts[code->count];
+        switch(inst->op) {
+            case IR_CONST:
+                loc[inst->dst] = layout->next_const++;
+                vm->frame[loc[inst->dst]] = const_value(vm->module, inst);
+                continue;
+            case IR_LOAD:
+                // nothing gets stored to a variable while a value loaded
+                // from it is still around, see ir.h
+                loc[inst->dst] = inst->a;
+                continue;
+            case IR_STORE:
+                if(inst->b == last_def && uses[inst->b] == 1) {
+                    code->insts[code->count - 1].dst = inst->a;
+                    loc[inst->b] = inst->a;
+                } else {
+                    *out = (VMInst){VM_MOV, inst->a, loc[inst->b], 0};
+                    code->count++;
+                }
+                last_def = UINT32_MAX;
+                continue;
+            case IR_RET:
+                *out = (VMInst){VM_RET, 0, 0, 0};
+                code->count++;
+                continue;
+            case IR_ITOF:
+            case IR_NEG:
+            case IR_NOT:
+                *out = (VMInst){select_op(vm->module, inst),
+                                layout->regs + inst->dst, loc[inst->a], 0};
+                break;
+            default:
+                *out = (VMInst){select_op(vm->module, inst),
+                                layout->regs + inst->dst, loc[inst->a],
+                                loc[inst->b]};
+                break;
+        }
+        loc[inst->dst] = out->dst;
+        last_def = inst->dst;
+        code->count++;
+    }
+}
+
+static inline int wrap(unsigned value) {
+    return (int)value;
+}
+
+static int int_pow(int base, int exp) {
+    if(exp < 0) {
+        // only 1 and -1 have an integer reciprocal
+        return base == 1 ? 1 : base == -1 ? (exp & 1 ? -1 : 1) : 0;
+    }
+    unsigned result = 1, b = base;
+    for(unsigned e = exp; e; e >>= 1) {
+        if(e & 1) {
+            result *= b;
+        }
+        b *= b;
+    }
+    return wrap(result);
+}
+
+static bool run(StilVM *vm, const VMCode *code) {
+    static void *handlers[] = {
+#define X(name) &&op_##name,
+        VM_OPS(X)
+#undef X
+    };
+    VMValue *f = vm->frame;
+    const VMInst *ip = code->insts;
+
+#define DISPATCH() goto *handlers[ip->op]
+#define NEXT()                                                                 \
+    do {                                                                       \
+        ip++;                                                                  \
+        DISPATCH();                                                            \
+    } while(0)
+#define A f[ip->a]
+#define B f[ip->b]
+#define D f[ip->dst]
+#define FAULT(why)                                                             \
+    do {                                                                       \
+        vm->fault = why;                                                       \
+        return false;                                                          \
+    } while(0)
+
+    DISPATCH();
+
+op_MOV:
+    D = A;
+    NEXT();
+op_ITOF:
+    D.r = A.i;
+    NEXT();
+op_NEG_INT:
+    D.i = wrap(0u - (unsigned)A.i);
+    NEXT();
+op_NEG_REAL:
+    D.r = -A.r;
+    NEXT();
+op_NOT:
+    D.i = !A.i;
+    NEXT();
+op_ADD_INT:
+    D.i = wrap((unsigned)A.i + (unsigned)B.i);
+    NEXT();
+op_ADD_REAL:
+    D.r = A.r + B.r;
+    NEXT();
+op_SUB_INT:
+    D.i = wrap((unsigned)A.i - (unsigned)B.i);
+    NEXT();
+op_SUB_REAL:
+    D.r = A.r - B.r;
+    NEXT();
+op_MUL_INT:
+    D.i = wrap((unsigned)A.i * (unsigned)B.i);
+    NEXT();
+op_MUL_REAL:
+    D.r = A.r * B.r;
+    NEXT();
+op_DIV_INT:
+    if(B.i == 0) {
+        FAULT("Division by zero");
+    }
+    D.i = B.i == -1 ? wrap(0u - (unsigned)A.i) : A.i / B.i;
+    NEXT();
+op_DIV_REAL:
+    D.r = A.r / B.r;
+    NEXT();
+op_MOD_INT:
+    if(B.i == 0) {
+        FAULT("Division by zero");
+    }
+    D.i = B.i == -1 ? 0 : A.i % B.i;
+    NEXT();
+op_POW_INT:
+    D.i = int_pow(A.i, B.i);
+    NEXT();
+op_POW_REAL:
+    D.r = pow(A.r, B.r);
+    NEXT();
+op_LT_INT:
+    D.i = A.i < B.i;
+    NEXT();
+op_LT_REAL:
+    D.i = A.r < B.r;
+    NEXT();
+op_LT_STR:
+    D.i = strcmp(A.s, B.s) < 0;
+    NEXT();
+op_LTE_INT:
+    D.i = A.i <= B.i;
+    NEXT();
+op_LTE_REAL:
+    D.i = A.r <= B.r;
+    NEXT();
+op_LTE_STR:
+    D.i = strcmp(A.s, B.s) <= 0;
+    NEXT();
+op_GT_INT:
+    D.i = A.i > B.i;
+    NEXT();
+op_GT_REAL:
+    D.i = A.r > B.r;
+    NEXT();
+op_GT_STR:
+    D.i = strcmp(A.s, B.s) > 0;
+    NEXT();
+op_GTE_INT:
+    D.i = A.i >= B.i;
+    NEXT();
+op_GTE_REAL:
+    D.i = A.r >= B.r;
+    NEXT();
+op_GTE_STR:
+    D.i = strcmp(A.s, B.s) >= 0;
+    NEXT();
+op_EQ_INT:
+    D.i = A.i == B.i;
+    NEXT();
+op_EQ_REAL:
+    D.i = A.r == B.r;
+    NEXT();
+op_EQ_STR:
+    D.i = strcmp(A.s, B.s) == 0;
+    NEXT();
+op_NE_INT:
+    D.i = A.i != B.i;
+    NEXT();
+op_NE_REAL:
+    D.i = A.r != B.r;
+    NEXT();
+op_NE_STR:
+    D.i = strcmp(A.s, B.s) != 0;
+    NEXT();
+op_AND:
+    D.i = A.i & B.i;
+    NEXT();
+op_OR:
+    D.i = A.i | B.i;
+    NEXT();
+op_XOR:
+    D.i = A.i ^ B.i;
+    NEXT();
+op_RET:
+    return true;
+
+#undef DISPATCH
+#undef NEXT
+#undef A
+#undef B
+#undef D
+#undef FAULT
+}
+
+void stil_vm_init(StilVM *vm, IRModule *module, uint32_t program) {
+    IRFunction *funcs = ir_function_list_items(module->funcs);
+    size_t n_funcs = module->funcs->count;
+
+    // every function gets the same stretch of the frame for its registers,
+    // only one of them runs at a time
+    uint32_t max_vregs = module->init.n_vregs;
+    size_t n_consts = 0;
+    for(size_t i = 0; i <= n_funcs; i++) {
+        IRFunction *func = i < n_funcs ? &funcs[i] : &module->init;
+        IRInst *insts = ir_inst_list_items(func->insts);
+        for(size_t j = 0; j < func->insts->count; j++) {
+            n_consts += insts[j].op == IR_CONST;
+        }
+        if(func->n_vregs > max_vregs) {
+            max_vregs = func->n_vregs;
+        }
+    }
+
+    uint32_t n_vars = module->vars->count;
+    *vm = (StilVM){
+        .module = module,
+        .code = stil_calloc(n_funcs ? n_funcs : 1, sizeof(VMCode)),
+        .frame_size = n_vars + max_vregs + n_consts,
+        .program = program,
+    };
+    vm->frame = stil_calloc(vm->frame_size, sizeof(VMValue));
+    // the frame starts zeroed, which is right for everything but strings
+    for(uint32_t i = 0; i < n_vars; i++) {
+        if(kind_of(module, ir_var_list_at(module->vars, i).type) ==
+           TYPE_STRING) {
+            vm->frame[i].s = "";
+        }
+    }
+
+    Layout layout = {
+        .regs = n_vars,
+        .next_const = n_vars + max_vregs,
+        .loc = stil_malloc((max_vregs + 1) * sizeof(uint32_t)),
+        .uses = stil_malloc((max_vregs + 1) * sizeof(uint32_t)),
+    };
+    compile_function(vm, &module->init, &vm->init, &layout);
+    for(size_t i = 0; i < n_funcs; i++) {
+        compile_function(vm, &funcs[i], &vm->code[i], &layout);
+    }
+    stil_free(layout.loc);
+    stil_free(layout.uses);
+
+    vm->fault = NULL;
+    run(vm, &vm->init);
+}
+
+void stil_vm_deinit(StilVM *vm) {
+    for(size_t i = 0; i < vm->module->funcs->count; i++) {
+        stil_free(vm->code[i].insts);
+    }
+    stil_free(vm->code);
+    stil_free(vm->init.insts);
+    stil_free(vm->frame);
+}
+
+bool stil_vm_cycle(StilVM *vm) {
+    vm->fault = NULL;
+    vm->cycles++;
+    return run(vm, &vm->code[vm->program]);
+}
+
+void stil_vm_dump(const StilVM *vm) {
+    IRModule *module = vm->module;
+    uint32_t state = ir_function_list_at(module->funcs, vm->program).state;
+    for(size_t i = 0; i < module->vars->count; i++) {
+        IRVar var = ir_var_list_at(module->vars, i);
+        if(var.storage == IR_TEMP ||
+           (var.storage == IR_STATE && var.owner != state)) {
+            continue;
+        }
+
+        VMValue value = vm->frame[i];
+        printf("%s = ", intern_str(var.name));
+        switch(kind_of(module, var.type)) {
+            case TYPE_INT:
+                printf("%d\n", value.i);
+                break;
+            case TYPE_REAL:
+                printf("%g\n", value.r);
+                break;
+            case TYPE_STRING:
+                printf("'%s'\n", value.s);
+                break;
+            case TYPE_BOOL:
+                printf("%s\n", value.i ? "TRUE" : "FALSE");
+                break;
+            default:
+                printf("?\n");
+                break;
+        }
+    }
+}
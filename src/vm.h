@@ -0,0 +1,57 @@
+#ifndef VM_H
+#define VM_H
+
+#include "ir.h"
+
+/*
+ * Runs a PROGRAM one scan cycle at a time. The IR is compiled to a register
+ * machine whose registers are a single flat frame per instance, laid out as
+ *
+ *   [ module variables | IR registers | constants ]
+ *
+ * Variables being registers like any other, a LOAD costs nothing and a
+ * STORE mostly turns into the instruction that computed the value writing
+ * straight into the variable, so x := a + b is one instruction. BOOLs are
+ * kept as 0 or 1 in i, so they share the INT instructions.
+ *
+ * Integer division by zero doesn't crash the host, it stops the cycle and
+ * stil_vm_cycle says so.
+ */
+
+typedef union _VMValue {
+    int i;
+    double r;
+    const char *s;
+} VMValue;
+
+typedef struct _VMInst {
+    uint32_t op;
+    uint32_t dst, a, b; // frame slots
+} VMInst;
+
+typedef struct _VMCode {
+    VMInst *insts;
+    size_t count;
+} VMCode;
+
+typedef struct _StilVM {
+    IRModule *module;
+    VMCode *code;  // one per IR function, in the same order
+    VMCode init;
+    VMValue *frame;
+    size_t frame_size;
+    uint32_t program; // the function run each cycle
+    uint64_t cycles;
+    const char *fault; // why the last cycle stopped early, NULL if it didn't
+} StilVM;
+
+// Compiles module and runs its init function, after which each
+// stil_vm_cycle runs the function at index program once
+void stil_vm_init(StilVM *vm, IRModule *module, uint32_t program);
+void stil_vm_deinit(StilVM *vm);
+// false if the cycle faulted, see vm->fault
+bool stil_vm_cycle(StilVM *vm);
+// the globals and the state of the program, one per line
+void stil_vm_dump(const StilVM *vm);
+
+#endif